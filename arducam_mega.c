@@ -20,259 +20,2004 @@
 /* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
 /* SOFTWARE. */
 
+#define DT_DRV_COMPAT arducam_mega
+
 #include "arducam_mega.h"
 #include <zephyr/device.h>
 #include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/video.h>
 #include <zephyr/fs/fs.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/syscall_handler.h>
+#include <zephyr/tracing/tracing.h>
 #include <zephyr/types.h>
+#include <stdio.h>
+#include <string.h>
 
 #define LOG_MODULE_NAME arducam_mega
 LOG_MODULE_REGISTER(LOG_MODULE_NAME);
-#define MAX_PATH        51200
-#define CONCAT_BUFF_LEN 30
-#define BUFFER_SIZE     0xff
-
-int received_length;
-
-struct spi_config spi_cfg = {
-	.frequency = DT_PROP(DT_NODELABEL(spi0), clock_frequency),
-	.operation = SPI_LOCK_ON | SPI_HOLD_ON_CS | SPI_OP_MODE_MASTER | SPI_TRANSFER_MSB |
-		     SPI_WORD_SET(8) | SPI_LINES_SINGLE,
-	.cs = SPI_CS_CONTROL_INIT(DT_NODELABEL(spi0), 0u),
-	.slave = 0,
+#define MAX_PATH        256
+
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER) && CONFIG_ARDUCAM_MEGA_SAVE_WRITER_TIMEOUT_MS > 0
+#define ARDUCAM_MEGA_SAVE_WRITER_WAIT K_MSEC(CONFIG_ARDUCAM_MEGA_SAVE_WRITER_TIMEOUT_MS)
+#else
+#define ARDUCAM_MEGA_SAVE_WRITER_WAIT K_FOREVER
+#endif
+
+BUILD_ASSERT(CONFIG_ARDUCAM_MEGA_SAVE_BUFFER_SIZE % CONFIG_ARDUCAM_MEGA_SAVE_BLOCK_SIZE == 0,
+	     "The save buffer must hold whole filesystem blocks");
+
+/* Shadow value for a resolution that has not been programmed yet */
+#define CAM_IMAGE_MODE_NONE 0xff
+
+#define ARDUCAM_MEGA_SPI_OPERATION                                                                 \
+	(SPI_OP_MODE_MASTER | SPI_TRANSFER_MSB | SPI_WORD_SET(8) | SPI_LINES_SINGLE)
+
+#ifndef VIDEO_PIX_FMT_JPEG
+#define VIDEO_PIX_FMT_JPEG video_fourcc('J', 'P', 'E', 'G')
+#endif
+#ifndef VIDEO_PIX_FMT_RGB565X
+/* RGB565 with the high byte of each pixel first, as the FIFO delivers it */
+#define VIDEO_PIX_FMT_RGB565X video_fourcc('R', 'G', 'B', 'R')
+#endif
+
+struct arducam_mega_reg {
+	uint8_t addr;
+	uint8_t val;
+};
+
+struct arducam_mega_resolution {
+	uint16_t width;
+	uint16_t height;
+	CAM_IMAGE_MODE mode;
+};
+
+static const struct arducam_mega_resolution resolutions[] = {
+	{160, 120, CAM_IMAGE_MODE_QQVGA},  {320, 240, CAM_IMAGE_MODE_QVGA},
+	{640, 480, CAM_IMAGE_MODE_VGA},    {800, 600, CAM_IMAGE_MODE_SVGA},
+	{1280, 720, CAM_IMAGE_MODE_HD},    {1280, 960, CAM_IMAGE_MODE_SXGAM},
+	{1600, 1200, CAM_IMAGE_MODE_UXGA}, {1920, 1080, CAM_IMAGE_MODE_FHD},
+	{2048, 1536, CAM_IMAGE_MODE_QXGA}, {2592, 1944, CAM_IMAGE_MODE_WQXGA2},
+	{96, 96, CAM_IMAGE_MODE_96X96},    {128, 128, CAM_IMAGE_MODE_128X128},
+	{320, 320, CAM_IMAGE_MODE_320X320},
+};
+
+#define ARDUCAM_MEGA_CAP(fmt, w, h)                                                                \
+	{                                                                                          \
+		.pixelformat = (fmt), .width_min = (w), .width_max = (w), .height_min = (h),       \
+		.height_max = (h), .width_step = 0, .height_step = 0,                              \
+	}
+#define ARDUCAM_MEGA_JPEG_CAP(w, h) ARDUCAM_MEGA_CAP(VIDEO_PIX_FMT_JPEG, w, h)
+/* Raw frames are offered at the sizes that fit the FIFO and embedded consumers */
+#define ARDUCAM_MEGA_RAW_CAPS(w, h)                                                                \
+	ARDUCAM_MEGA_CAP(VIDEO_PIX_FMT_RGB565X, w, h), ARDUCAM_MEGA_CAP(VIDEO_PIX_FMT_YUYV, w, h)
+
+static const struct video_format_cap fmts[] = {
+	ARDUCAM_MEGA_JPEG_CAP(160, 120),   ARDUCAM_MEGA_JPEG_CAP(320, 240),
+	ARDUCAM_MEGA_JPEG_CAP(640, 480),   ARDUCAM_MEGA_JPEG_CAP(800, 600),
+	ARDUCAM_MEGA_JPEG_CAP(1280, 720),  ARDUCAM_MEGA_JPEG_CAP(1280, 960),
+	ARDUCAM_MEGA_JPEG_CAP(1600, 1200), ARDUCAM_MEGA_JPEG_CAP(1920, 1080),
+	ARDUCAM_MEGA_JPEG_CAP(2048, 1536), ARDUCAM_MEGA_JPEG_CAP(2592, 1944),
+	ARDUCAM_MEGA_JPEG_CAP(96, 96),     ARDUCAM_MEGA_JPEG_CAP(128, 128),
+	ARDUCAM_MEGA_JPEG_CAP(320, 320),   ARDUCAM_MEGA_RAW_CAPS(96, 96),
+	ARDUCAM_MEGA_RAW_CAPS(128, 128),   ARDUCAM_MEGA_RAW_CAPS(320, 240),
+	ARDUCAM_MEGA_RAW_CAPS(320, 320),   ARDUCAM_MEGA_RAW_CAPS(640, 480),
+	{0},
+};
+
+/* RGB565 and YUV422 both take two bytes per pixel */
+#define ARDUCAM_MEGA_RAW_BPP 2
+
+static const struct arducam_mega_resolution *arducam_mega_mode_resolution(CAM_IMAGE_MODE mode)
+{
+	for (int i = 0; i < ARRAY_SIZE(resolutions); i++) {
+		if (resolutions[i].mode == mode) {
+			return &resolutions[i];
+		}
+	}
+	return NULL;
+}
+
+/* Cycle and SPI transaction marks at the start of a profiled phase */
+struct camera_phase {
+	uint32_t start;
+	uint32_t transactions;
 };
 
-#define SPI_DEV_NAME DEVICE_DT_NAME(DT_NODELABEL(spi0))
-const struct device *spi;
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+#define CAMERA_STATS_INC(data, var)     STATS_INC((data)->stats, var)
+#define CAMERA_STATS_INCN(data, var, n) STATS_INCN((data)->stats, var, n)
+#else
+#define CAMERA_STATS_INC(data, var)     ARG_UNUSED(data)
+#define CAMERA_STATS_INCN(data, var, n) ARG_UNUSED(n)
+#endif
+
+#if defined(CONFIG_ARDUCAM_MEGA_TRACING)
+#define CAMERA_TRACE(name, arg0, arg1) sys_trace_named_event(name, arg0, arg1)
+#else
+#define CAMERA_TRACE(name, arg0, arg1)                                                             \
+	do {                                                                                       \
+		ARG_UNUSED(arg0);                                                                  \
+		ARG_UNUSED(arg1);                                                                  \
+	} while (0)
+#endif
+
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+STATS_NAME_START(arducam_mega)
+STATS_NAME(arducam_mega, spi_transactions)
+STATS_NAME(arducam_mega, spi_bytes)
+STATS_NAME(arducam_mega, spi_retries)
+STATS_NAME(arducam_mega, idle_waits)
+STATS_NAME(arducam_mega, idle_wait_us)
+STATS_NAME(arducam_mega, capture_polls)
+STATS_NAME(arducam_mega, fs_writes)
+STATS_NAME(arducam_mega, fs_write_us)
+STATS_NAME(arducam_mega, fs_write_max_us)
+STATS_NAME(arducam_mega, frames)
+STATS_NAME(arducam_mega, frame_errors)
+STATS_NAME_END(arducam_mega);
+#endif
+
+/* @p bytes counts every byte clocked on the bus, command and dummies included */
+static inline void camera_count_transaction(const struct device *dev, uint32_t bytes)
+{
+	struct arducam_mega_data *data = dev->data;
+
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	data->spi_transactions++;
+#endif
+	CAMERA_STATS_INC(data, spi_transactions);
+	CAMERA_STATS_INCN(data, spi_bytes, bytes);
+}
+
+static inline void camera_phase_begin(const struct device *dev, struct camera_phase *phase)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	struct arducam_mega_data *data = dev->data;
+
+	phase->start = k_cycle_get_32();
+	phase->transactions = data->spi_transactions;
+#endif
+}
+
+static inline void camera_phase_end(const struct device *dev, struct camera_phase *phase,
+				    enum arducam_mega_phase id)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	struct arducam_mega_data *data = dev->data;
 
-#define LED DT_ALIAS(csled)
-struct gpio_dt_spec spec = GPIO_DT_SPEC_GET(LED, gpios);
+	data->profile.cycles[id] += k_cycle_get_32() - phase->start;
+	data->profile.transactions[id] += data->spi_transactions - phase->transactions;
+#endif
+}
 
-uint8_t camera_bus_read(uint8_t address)
+/*
+ * Runs one register access, repeating it up to CONFIG_ARDUCAM_MEGA_SPI_RETRIES
+ * times if the controller reports an error. Only register reads and writes
+ * can be repeated as a whole. A failed FIFO transfer may still have clocked
+ * out part of the FIFO and advanced its read pointer, so a retry would
+ * return shifted data; FIFO reads go to the bus once and fail the readout.
+ */
+static int camera_spi_transceive(const struct device *dev, const struct spi_dt_spec *spec,
+				 const struct spi_buf_set *tx_bufs,
+				 const struct spi_buf_set *rx_bufs)
 {
 	int ret;
-	struct spi_buf tx_buf[1];
-	tx_buf[0].buf = &address;
-	tx_buf[0].len = 1;
-	struct spi_buf_set tx_bufs = {.buffers = tx_buf, .count = 1};
-	spi_cfg.operation |= SPI_HOLD_ON_CS;
-	spi_cfg.operation |= SPI_LOCK_ON;
 
-	gpio_pin_toggle_dt(&spec);
-	ret = spi_write(spi, &spi_cfg, &tx_bufs);
-	uint8_t rxdata[2];
-	struct spi_buf rx_buf[1] = {
-		{.buf = rxdata, .len = 2},
+	for (int attempt = 0;; attempt++) {
+		ret = spi_transceive_dt(spec, tx_bufs, rx_bufs);
+		if (ret >= 0 || attempt >= CONFIG_ARDUCAM_MEGA_SPI_RETRIES) {
+			return ret;
+		}
+		LOG_WRN("%s: SPI transfer failed %d, retrying", dev->name, ret);
+		CAMERA_STATS_INC((struct arducam_mega_data *)dev->data, spi_retries);
+	}
+}
+
+static int camera_bus_read(const struct device *dev, const struct spi_dt_spec *spec,
+			   uint8_t address, uint8_t *value)
+{
+	int ret;
+	struct spi_buf tx_buf[1] = {
+		{.buf = &address, .len = 1},
+	};
+	struct spi_buf_set tx_bufs = {.buffers = tx_buf, .count = 1};
+	/* Address echo and dummy byte precede the register value */
+	struct spi_buf rx_buf[2] = {
+		{.buf = NULL, .len = 2},
+		{.buf = value, .len = 1},
 	};
 	struct spi_buf_set rx_bufs = {.buffers = rx_buf, .count = 2};
 
-	ret = spi_read(spi, &spi_cfg, &rx_bufs);
-	gpio_pin_toggle_dt(&spec);
-	spi_release(spi, &spi_cfg);
-	return rxdata[1];
+	camera_count_transaction(dev, 3);
+	ret = camera_spi_transceive(dev, spec, &tx_bufs, &rx_bufs);
+	if (ret < 0) {
+		LOG_ERR("%s: register 0x%02x read failed %d", dev->name, address, ret);
+	}
+	return ret;
 }
 
-uint8_t camera_read_reg(uint8_t addr)
+static int camera_read_reg(const struct device *dev, uint8_t addr, uint8_t *value)
 {
-	return camera_bus_read(addr & 0x7F);
+	const struct arducam_mega_config *cfg = dev->config;
+
+	return camera_bus_read(dev, &cfg->spi_dt, addr & 0x7F, value);
 }
 
-uint8_t camera_bus_write(uint8_t address, uint8_t value)
+static int camera_bus_write(const struct device *dev, uint8_t address, uint8_t value)
 {
+	const struct arducam_mega_config *cfg = dev->config;
+	int ret;
+	uint8_t txdata[2] = {address, value};
+	struct spi_buf tx_buf[1] = {
+		{.buf = txdata, .len = 2},
+	};
+	struct spi_buf_set tx_bufs = {.buffers = tx_buf, .count = 1};
 
-	struct spi_buf tx_buf[2];
-	tx_buf[0].buf = &address;
-	tx_buf[0].len = 1;
-	tx_buf[1].buf = &value;
-	tx_buf[1].len = 1;
-	struct spi_buf_set tx_bufs = {.buffers = tx_buf, .count = 2};
-	spi_cfg.operation |= SPI_HOLD_ON_CS;
-	spi_cfg.operation |= SPI_LOCK_ON;
-	gpio_pin_toggle_dt(&spec);
-	spi_write(spi, &spi_cfg, &tx_bufs);
-	gpio_pin_toggle_dt(&spec);
-	k_sleep(K_MSEC(10));
-	return 1;
+	camera_count_transaction(dev, sizeof(txdata));
+	ret = camera_spi_transceive(dev, &cfg->spi_dt, &tx_bufs, NULL);
+	if (ret < 0) {
+		LOG_ERR("%s: register 0x%02x write failed %d", dev->name, address & 0x7F, ret);
+	}
+	return ret;
 }
-void camera_write_reg(uint8_t addr, uint8_t val)
+
+static int camera_write_reg(const struct device *dev, uint8_t addr, uint8_t val)
 {
-	camera_bus_write(addr | 0x80, val);
+	return camera_bus_write(dev, addr | 0x80, val);
 }
 
-void camera_wait_idle()
+/* Waits up to CONFIG_ARDUCAM_MEGA_IDLE_TIMEOUT_MS for the sensor to take the last write */
+static int camera_wait_idle(const struct device *dev)
 {
-	while ((camera_read_reg(CAM_REG_SENSOR_STATE) & 0X03) != CAM_REG_SENSOR_STATE_IDLE) {
+	struct arducam_mega_data *data = dev->data;
+	int64_t deadline = k_uptime_get() + CONFIG_ARDUCAM_MEGA_IDLE_TIMEOUT_MS;
+	uint32_t start = k_cycle_get_32();
+	uint32_t elapsed;
+	uint8_t state;
+	int ret;
+
+	CAMERA_TRACE("arducam_mega_wait_idle", 0, 0);
+	while (true) {
+		ret = camera_read_reg(dev, CAM_REG_SENSOR_STATE, &state);
+		if (ret < 0) {
+			return ret;
+		}
+		if ((state & 0X03) == CAM_REG_SENSOR_STATE_IDLE) {
+			break;
+		}
+		if (k_uptime_get() >= deadline) {
+			LOG_ERR("%s: sensor busy for %d ms", dev->name,
+				CONFIG_ARDUCAM_MEGA_IDLE_TIMEOUT_MS);
+			return -ETIMEDOUT;
+		}
 		k_sleep(K_MSEC(2));
 	}
+	elapsed = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	CAMERA_STATS_INC(data, idle_waits);
+	CAMERA_STATS_INCN(data, idle_wait_us, elapsed);
+	CAMERA_TRACE("arducam_mega_idle", elapsed, 0);
+	return 0;
 }
 
-uint8_t camera_get_bit(uint8_t addr, uint8_t bit)
+/* ARDUCHIP registers live in the FPGA and take effect immediately */
+static bool camera_reg_is_arduchip(uint8_t addr)
 {
-	uint8_t temp;
-	temp = camera_read_reg(addr);
-	temp = temp & bit;
-	return temp;
+	return addr == ARDUCHIP_TEST1 || addr == ARDUCHIP_FRAMES || addr == ARDUCHIP_FIFO;
 }
 
-uint8_t camera_read_byte()
+/*
+ * Writes a batch of registers back to back. Sensor registers are relayed to
+ * the sensor by the FPGA, so the sensor is waited on once after the batch
+ * rather than after every write. The batch is one transaction: no other
+ * thread's registers go out until the sensor is idle again. A failed batch
+ * may have gone out in part, so the settings shadow is no longer trusted.
+ */
+static int camera_write_regs(const struct device *dev, const struct arducam_mega_reg *regs,
+			     size_t count)
 {
-	int ret;
-	uint8_t rxdata[1];
-	struct spi_buf rx_buf[1] = {
-		{.buf = rxdata, .len = 1},
+	struct arducam_mega_data *data = dev->data;
+	bool sensor = false;
+	int ret = 0;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	for (size_t i = 0; i < count && ret == 0; i++) {
+		ret = camera_write_reg(dev, regs[i].addr, regs[i].val);
+		sensor |= !camera_reg_is_arduchip(regs[i].addr);
+	}
+	if (ret == 0 && sensor) {
+		ret = camera_wait_idle(dev);
+	}
+	if (ret < 0) {
+		data->settings_valid = 0;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+/*
+ * Serializes captures and their readout, so that two threads never trigger
+ * the FIFO or drain it under each other. Zephyr mutexes nest, which lets an
+ * entry point call another one. An asynchronous readout owns the FIFO until
+ * it signals completion.
+ */
+static int camera_capture_lock(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	k_mutex_lock(&data->capture_lock, K_FOREVER);
+#if defined(CONFIG_ARDUCAM_MEGA_ASYNC)
+	if (atomic_get(&data->async_busy)) {
+		k_mutex_unlock(&data->capture_lock);
+		return -EBUSY;
+	}
+#endif
+	return 0;
+}
+
+static void camera_capture_unlock(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	k_mutex_unlock(&data->capture_lock);
+}
+
+/* Resets the sensor and forgets the configuration shadowed in the data */
+static int camera_sensor_reset(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg reset_regs[] = {
+		{CAM_REG_SENSOR_RESET, CAM_SENSOR_RESET_ENABLE},
 	};
-	struct spi_buf_set rx_bufs = {.buffers = rx_buf, .count = 1};
+	const struct arducam_mega_reg init_regs[] = {
+		{ARDUCHIP_FIFO, FIFO_CLEAR_ID_MASK},
+		{ARDUCHIP_FIFO, FIFO_START_MASK},
+	};
+	struct camera_phase phase;
+	int ret;
+
+	camera_phase_begin(dev, &phase);
+	ret = camera_write_regs(dev, reset_regs, ARRAY_SIZE(reset_regs));
+	if (ret == 0) {
+		ret = camera_write_regs(dev, init_regs, ARRAY_SIZE(init_regs));
+	}
+	if (ret == 0) {
+		k_sleep(K_MSEC(300));
+	}
+	camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_RESET);
+
+	data->currentPixelFormat = CAM_IMAGE_PIX_FMT_NONE;
+	data->currentPictureMode = CAM_IMAGE_MODE_NONE;
+	k_mutex_lock(&data->lock, K_FOREVER);
+	data->settings_valid = 0;
+	k_mutex_unlock(&data->lock);
+	if (ret < 0) {
+		LOG_ERR("%s: sensor reset failed %d", dev->name, ret);
+	}
+	return ret;
+}
+
+static void camera_int_handler(const struct device *port, struct gpio_callback *cb,
+			       gpio_port_pins_t pins)
+{
+	struct arducam_mega_data *data = CONTAINER_OF(cb, struct arducam_mega_data, int_cb);
+
+	k_sem_give(&data->capture_sem);
+}
+
+/*
+ * Waits for CAP_DONE. With an interrupt line the thread sleeps until the
+ * camera signals the frame; otherwise the flag is polled with a backoff that
+ * doubles from CAPTURE_POLL_MIN_US to CAPTURE_POLL_MAX_US.
+ */
+static int camera_wait_capture(const struct device *dev)
+{
+	const struct arducam_mega_config *cfg = dev->config;
+	struct arducam_mega_data *data = dev->data;
+	int64_t deadline = k_uptime_get() + CONFIG_ARDUCAM_MEGA_CAPTURE_TIMEOUT_MS;
+	uint32_t interval = CONFIG_ARDUCAM_MEGA_CAPTURE_POLL_MIN_US;
+	uint8_t trig;
+	int ret;
 
-	gpio_pin_toggle_dt(&spec);
-	struct spi_buf tx_buf[1];
+	if (cfg->int_gpio.port != NULL) {
+		/* On timeout fall back to polling until the deadline */
+		k_sem_take(&data->capture_sem, K_MSEC(CONFIG_ARDUCAM_MEGA_CAPTURE_TIMEOUT_MS));
+	}
+
+	while (true) {
+		ret = camera_read_reg(dev, ARDUCHIP_TRIG, &trig);
+		if (ret < 0) {
+			return ret;
+		}
+		if (trig & CAP_DONE_MASK) {
+			break;
+		}
+		CAMERA_STATS_INC(data, capture_polls);
+		if (k_uptime_get() >= deadline) {
+			LOG_ERR("%s: capture timed out", dev->name);
+			return -ETIMEDOUT;
+		}
+		k_sleep(K_USEC(interval));
+		interval = MIN(interval * 2, CONFIG_ARDUCAM_MEGA_CAPTURE_POLL_MAX_US);
+	}
+	return 0;
+}
 
+#if !defined(CONFIG_ARDUCAM_MEGA_BURST_READ)
+static int camera_read_byte(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
 	uint8_t send_cmd = SINGLE_FIFO_READ;
-	tx_buf[0].buf = &send_cmd;
-	tx_buf[0].len = 1;
+	uint8_t rxdata = 0;
+	struct spi_buf tx_buf[1] = {
+		{.buf = &send_cmd, .len = 1},
+	};
+	struct spi_buf_set tx_bufs = {.buffers = tx_buf, .count = 1};
+	/* Command echo and dummy byte precede the FIFO byte */
+	struct spi_buf rx_buf[2] = {
+		{.buf = NULL, .len = 2},
+		{.buf = &rxdata, .len = 1},
+	};
+	struct spi_buf_set rx_bufs = {.buffers = rx_buf, .count = 2};
+	int ret;
+
+	camera_count_transaction(dev, 3);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = spi_transceive_dt(&data->fifo_spi, &tx_bufs, &rx_bufs);
+	k_mutex_unlock(&data->lock);
+	if (ret < 0) {
+		LOG_ERR("FIFO read failed %d", ret);
+		return ret;
+	}
+	data->receivedLength -= 1;
+	return rxdata;
+}
+#endif
+
+#if defined(CONFIG_ARDUCAM_MEGA_BURST_READ)
+/* Lays out the receive side of a BURST_FIFO_READ transfer into @p buffer */
+static size_t camera_burst_bufs(struct arducam_mega_data *data, struct spi_buf *rx_buf,
+				uint8_t *buffer, uint32_t length)
+{
+	size_t count = 0;
+
+	/* Discard the byte clocked in while the command goes out */
+	rx_buf[count++] = (struct spi_buf){.buf = NULL, .len = 1};
+	/* The first burst after a capture is preceded by one dummy byte */
+	if (data->burstFirstFlag == 0) {
+		rx_buf[count++] = (struct spi_buf){.buf = NULL, .len = 1};
+		data->burstFirstFlag = 1;
+	}
+	rx_buf[count++] = (struct spi_buf){.buf = buffer, .len = length};
+	return count;
+}
 
+static int camera_burst_read(const struct device *dev, uint8_t *buffer, uint32_t length)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+	uint8_t send_cmd = BURST_FIFO_READ;
+	struct spi_buf tx_buf[1] = {
+		{.buf = &send_cmd, .len = 1},
+	};
 	struct spi_buf_set tx_bufs = {.buffers = tx_buf, .count = 1};
-	spi_cfg.operation |= SPI_HOLD_ON_CS;
-	spi_cfg.operation |= SPI_LOCK_ON;
-	ret = spi_write(spi, &spi_cfg, &tx_bufs);
+	struct spi_buf rx_buf[3];
+	struct spi_buf_set rx_bufs = {.buffers = rx_buf};
+
+	if (length > data->receivedLength) {
+		length = data->receivedLength;
+	}
+	if (length == 0) {
+		return 0;
+	}
+	rx_bufs.count = camera_burst_bufs(data, rx_buf, buffer, length);
+
+	/* Every buffer but the data one is a single discarded byte */
+	camera_count_transaction(dev, length + rx_bufs.count - 1);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = spi_transceive_dt(&data->fifo_spi, &tx_bufs, &rx_bufs);
+	k_mutex_unlock(&data->lock);
+	if (ret < 0) {
+		LOG_ERR("Burst FIFO read failed %d", ret);
+		return ret;
+	}
+	data->receivedLength -= length;
+	return length;
+}
+#endif
 
-	send_cmd = 0x00;
-	tx_buf[0].buf = &send_cmd;
-	ret = spi_write(spi, &spi_cfg, &tx_bufs);
+/* Returns the number of bytes read, 0 once the frame is drained, or a negative errno */
+static int camera_read_fifo(const struct device *dev, uint8_t *buffer, uint32_t length)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_BURST_READ)
+	return camera_burst_read(dev, buffer, length);
+#else
+	struct arducam_mega_data *data = dev->data;
+	uint32_t i;
+	int ret;
 
-	ret = spi_read(spi, &spi_cfg, &rx_bufs);
-	gpio_pin_toggle_dt(&spec);
-	received_length -= 1;
-	return rxdata[0];
+	if (length > data->receivedLength) {
+		length = data->receivedLength;
+	}
+	for (i = 0; i < length; i++) {
+		ret = camera_read_byte(dev);
+		if (ret < 0) {
+			return ret;
+		}
+		buffer[i] = ret;
+	}
+	return length;
+#endif
 }
 
-void camera_save_fifo(const char *base_path, uint32_t length, char *filename)
+/* Folds @p length bytes into the readout CRC, which stays 0 without CONFIG_ARDUCAM_MEGA_CRC */
+static inline uint32_t camera_crc_update(uint32_t crc, const uint8_t *buffer, uint32_t length)
 {
+#if defined(CONFIG_ARDUCAM_MEGA_CRC)
+	return crc32_ieee_update(crc, buffer, length);
+#else
+	return 0;
+#endif
+}
 
-	uint8_t imageData = 0, imageDataNext = 0, headFlag = 0;
-	unsigned int i = 0;
-	uint8_t imageBuff[BUFFER_SIZE] = {0};
+/* Hands @p length bytes to the stream callback and folds them into the CRC */
+static int camera_deliver(struct arducam_mega_stream *stream, uint8_t *buffer, uint32_t length)
+{
+	/* Before the callback, which may scribble over the chunk it was lent */
+	uint32_t crc = camera_crc_update(stream->crc, buffer, length);
 	int ret;
-	uint8_t sd_write_counts = 0;
-	uint8_t file_opened = 0;
 
-	received_length = length;
-	char path[MAX_PATH];
-	struct fs_file_t file;
-	int base = strlen(base_path);
+	ret = stream->function(buffer, length, stream->user_data);
+	if (ret != 0) {
+		return ret;
+	}
+	stream->delivered += length;
+	stream->crc = crc;
+	return 0;
+}
 
-	fs_file_t_init(&file);
+/* Trims a chunk to the JPEG SOI/EOI markers and lends it to the stream callback */
+static int camera_deliver_chunk(struct arducam_mega_stream *stream, uint8_t *buffer,
+				uint32_t count)
+{
+	struct arducam_mega_jpeg_scanner *scanner = &stream->scanner;
+	uint32_t base = scanner->offset;
+	uint32_t start = 0;
+	uint8_t soi_prefix = 0xff;
+	size_t used;
+	int status, ret;
 
-	if (base >= (sizeof(path) - CONCAT_BUFF_LEN)) {
-		LOG_ERR("Not enough concatenation buffer to create file paths");
-		return;
+	stream->total += count;
+	if (stream->raw) {
+		/* Raw frames fill the FIFO exactly, pass everything through */
+		return camera_deliver(stream, buffer, count);
+	}
+	status = arducam_mega_jpeg_scan(scanner, buffer, count, &used);
+	if (status < 0) {
+		LOG_ERR("Malformed JPEG stream at offset %u", scanner->offset);
+		return status;
+	}
+	if (scanner->soi == ARDUCAM_MEGA_JPEG_NONE) {
+		return 0;
 	}
 
-	strncpy(path, base_path, sizeof(path));
-
-	path[base++] = '/';
-	path[base] = 0;
-	strcat(&path[base], filename);
-	while (received_length) {
-		imageData = imageDataNext;
-		imageDataNext = camera_read_byte();
-		if (headFlag == 1) {
-			imageBuff[i++] = imageDataNext;
-			if (i >= BUFFER_SIZE) {
-				ret = fs_write(&file, imageBuff, i);
-				sd_write_counts++;
-				i = 0;
-			}
+	if (scanner->soi >= base) {
+		start = scanner->soi - base;
+	} else if (stream->delivered == 0) {
+		/* SOI marker straddles two chunks */
+		ret = camera_deliver(stream, &soi_prefix, 1);
+		if (ret != 0) {
+			return ret;
 		}
-		if (imageData == 0xff && imageDataNext == 0xd8 && file_opened == 0) {
-			ret = fs_open(&file, path, FS_O_CREATE | FS_O_WRITE | FS_O_APPEND);
-			if (ret != 0) {
-				LOG_ERR("Failed to create file %s %d", path, ret);
-				return;
-			}
-			LOG_INF("Opened file successfully\n");
-			file_opened = 1;
-			headFlag = 1;
-			imageBuff[i++] = imageData;
-			imageBuff[i++] = imageDataNext;
-		}
-		if (imageData == 0xff && imageDataNext == 0xd9) {
-			headFlag = 0;
-			LOG_INF("Closed file with sd_write_counts %d\n", sd_write_counts);
-			fs_write(&file, imageBuff, i);
-
-			fs_close(&file);
-			i = 0;
+	}
+
+	if (status == ARDUCAM_MEGA_JPEG_COMPLETE) {
+		stream->done = 1;
+	}
+	if (used > start) {
+		/* Lend the chunk straight out of the FIFO buffer */
+		return camera_deliver(stream, &buffer[start], used - start);
+	}
+	return 0;
+}
+
+/* Records a completed readout for arducam_mega_get_readout() */
+static void camera_readout_done(struct arducam_mega_data *data, uint32_t length, uint32_t crc)
+{
+	data->readout = (struct arducam_mega_readout){
+		.length = length,
+		.crc32 = crc,
+	};
+	data->readout_valid = 1;
+}
+
+static void camera_log_throughput(uint32_t total, int64_t elapsed)
+{
+	elapsed = MAX(elapsed, 1);
+	LOG_INF("FIFO readout of %u bytes took %lld ms (%llu bytes/s)", total, elapsed,
+		(uint64_t)total * MSEC_PER_SEC / elapsed);
+}
+
+static int camera_stream_fifo(const struct device *dev, BUFFER_CALLBACK function,
+			      uint32_t block_size, void *user_data)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_stream stream = {
+		.function = function,
+		.user_data = user_data,
+		.raw = data->currentPixelFormat != CAM_IMAGE_PIX_FMT_JPG,
+	};
+	struct camera_phase phase;
+	int count;
+	int ret = 0;
+	int64_t elapsed;
+
+	arducam_mega_jpeg_scan_init(&stream.scanner);
+	elapsed = k_uptime_get();
+	while (data->receivedLength && !stream.done) {
+		camera_phase_begin(dev, &phase);
+		count = camera_read_fifo(dev, data->fifo_buff, block_size);
+		camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_READOUT);
+		if (count <= 0) {
+			ret = count < 0 ? count : -EIO;
+			break;
+		}
+		camera_phase_begin(dev, &phase);
+		ret = camera_deliver_chunk(&stream, data->fifo_buff, count);
+		camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_WRITE);
+		if (ret != 0) {
 			break;
 		}
 	}
+	camera_log_throughput(stream.total, k_uptime_get() - elapsed);
+	if (ret == 0 && !stream.raw && !stream.done) {
+		/* The FIFO ran dry before the EOI marker, the frame is truncated */
+		LOG_ERR("%s: no JPEG end marker in %u FIFO bytes", dev->name, stream.total);
+		ret = -EBADMSG;
+	}
+	if (ret != 0) {
+		return ret;
+	}
+	camera_readout_done(data, stream.delivered, stream.crc);
+	return stream.delivered;
 }
 
-int arducam_mega_capture_image(CAM_IMAGE_MODE mode, CAM_IMAGE_PIX_FMT pixel_format)
+#if defined(CONFIG_ARDUCAM_MEGA_ASYNC)
+static void camera_async_done(const struct device *spi_dev, int result, void *user_data)
 {
-	camera_write_reg(CAM_REG_SENSOR_RESET, CAM_SENSOR_RESET_ENABLE);
-	camera_wait_idle();
-	camera_write_reg(0x04, 0x01);
-	camera_write_reg(0x04, 0x02);
-	camera_wait_idle();
-	k_sleep(K_MSEC(300));
+	struct arducam_mega_data *data = user_data;
 
-	/* Set format JPG */
-	camera_write_reg(CAM_REG_FORMAT,
-			 CAM_IMAGE_PIX_FMT_JPG); // set the data format
-	camera_wait_idle();                      // Wait I2c Idle
+	if (result < 0 && data->async_result == 0) {
+		data->async_result = result;
+	}
+	k_work_submit_to_queue(&data->workq, &data->async_work);
+}
 
-	/* Set capture resolution */
-	camera_write_reg(CAM_REG_CAPTURE_RESOLUTION, CAM_SET_CAPTURE_MODE | mode);
-	camera_wait_idle(); // Wait I2c Idle
+static int camera_burst_read_async(const struct device *dev, uint8_t index, uint32_t length)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
 
-	/* Clear fifo flags */
+	length = MIN(length, data->receivedLength);
+	data->async_cmd = BURST_FIFO_READ;
+	data->async_tx_buf = (struct spi_buf){.buf = &data->async_cmd, .len = 1};
+	data->async_tx_bufs = (struct spi_buf_set){.buffers = &data->async_tx_buf, .count = 1};
+	data->async_rx_bufs.buffers = data->async_rx_buf;
+	data->async_rx_bufs.count =
+		camera_burst_bufs(data, data->async_rx_buf, data->async_buffs[index], length);
 
-	camera_write_reg(ARDUCHIP_FIFO, FIFO_CLEAR_ID_MASK);
-	/* Start capture */
-	camera_write_reg(ARDUCHIP_FIFO, FIFO_START_MASK);
-
-	while (camera_get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK) == 0)
-		;
-	uint32_t len1, len2, len3, length = 0;
-	len1 = camera_read_reg(FIFO_SIZE1);
-	len2 = camera_read_reg(FIFO_SIZE2);
-	len3 = camera_read_reg(FIFO_SIZE3);
-	length = ((len3 << 16) | (len2 << 8) | len1) & 0xffffff;
-	LOG_INF("Image length is %d\n", length);
-	return length;
+	camera_count_transaction(dev, length + data->async_rx_bufs.count - 1);
+	ret = spi_transceive_cb(data->fifo_spi.bus, &data->fifo_spi.config, &data->async_tx_bufs,
+				&data->async_rx_bufs, camera_async_done, data);
+	if (ret < 0) {
+		return ret;
+	}
+	data->async_count[index] = length;
+	data->async_index = index;
+	data->receivedLength -= length;
+	return 0;
 }
-int arducam_mega_save_image(char *filename, const char *mount_point, int image_length)
+
+static void camera_async_finish(struct arducam_mega_data *data)
 {
-	LOG_INF("Saving image\n");
-	camera_save_fifo(mount_point, image_length, filename);
+	struct k_poll_signal *signal = data->async_signal;
+	int result;
+
+	if (data->async_result == 0 && !data->async_stream.raw && !data->async_stream.done) {
+		LOG_ERR("%s: no JPEG end marker in %u FIFO bytes", data->dev->name,
+			data->async_stream.total);
+		data->async_result = -EBADMSG;
+	}
+	if (data->async_result == 0) {
+		camera_readout_done(data, data->async_stream.delivered, data->async_stream.crc);
+	}
+	result = data->async_result != 0 ? data->async_result : data->async_stream.delivered;
+
+	camera_log_throughput(data->async_stream.total, k_uptime_get() - data->async_start);
+	/* Free the camera before waking the caller so that it can start the next capture */
+	atomic_set(&data->async_busy, 0);
+	if (signal != NULL) {
+		k_poll_signal_raise(signal, result);
+	}
+}
+
+static void camera_async_work(struct k_work *work)
+{
+	struct arducam_mega_data *data = CONTAINER_OF(work, struct arducam_mega_data, async_work);
+	uint8_t index = data->async_index;
+	bool pending = false;
+	int ret;
+
+	if (data->async_result == 0 && !data->async_stream.done && data->receivedLength) {
+		/* Start filling the other buffer before handing this one out */
+		ret = camera_burst_read_async(data->dev, index ^ 1, data->blockSize);
+		if (ret < 0) {
+			data->async_result = ret;
+		} else {
+			pending = true;
+		}
+	}
+	if (data->async_result == 0 && !data->async_stream.done) {
+		ret = camera_deliver_chunk(&data->async_stream, data->async_buffs[index],
+					   data->async_count[index]);
+		if (ret != 0) {
+			data->async_result = ret;
+		}
+	}
+	if (!pending) {
+		camera_async_finish(data);
+	}
+}
+#endif /* CONFIG_ARDUCAM_MEGA_ASYNC */
+
+struct camera_file_sink {
+	const struct device *dev;
+	struct fs_file_t file;
+	const char *path;
+	uint8_t *buff;
+	uint32_t fill;
+	uint32_t sd_write_counts;
+	uint8_t file_opened;
+	int error;
+};
+
+/* Writes straight to the file, opening it on the first write */
+static int camera_file_commit(struct camera_file_sink *sink, const uint8_t *buffer,
+			      uint32_t length)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+	struct arducam_mega_data *data = sink->dev->data;
+#endif
+	uint32_t start, elapsed;
+	int ret;
+
+	if (sink->file_opened == 0) {
+		ret = fs_open(&sink->file, sink->path, FS_O_CREATE | FS_O_WRITE);
+		if (ret == 0) {
+			/* Start at offset 0 so that full buffers land on block boundaries */
+			sink->file_opened = 1;
+			ret = fs_truncate(&sink->file, 0);
+		}
+		if (ret != 0) {
+			LOG_ERR("Failed to create file %s %d", sink->path, ret);
+			return ret;
+		}
+		LOG_INF("Opened file successfully\n");
+	}
+	start = k_cycle_get_32();
+	ret = fs_write(&sink->file, buffer, length);
+	elapsed = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	CAMERA_TRACE("arducam_mega_fs_write", length, elapsed);
+	if (ret < 0) {
+		return ret;
+	}
+	if (ret != length) {
+		return -ENOSPC;
+	}
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+	STATS_INC(data->stats, fs_writes);
+	STATS_INCN(data->stats, fs_write_us, elapsed);
+	if (elapsed > data->stats.fs_write_max_us) {
+		STATS_SET(data->stats, fs_write_max_us, elapsed);
+	}
+#endif
+	sink->sd_write_counts++;
 	return 0;
 }
 
-int arducam_mega_get_id()
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER)
+/* Writes the buffers handed over by camera_file_flush() while the FIFO is read */
+static void camera_save_writer(void *p1, void *p2, void *p3)
 {
-	uint8_t cameraID;
-	cameraID = camera_read_reg(CAM_REG_SENSOR_ID);
-	LOG_INF("Sensor camera ID is %x\n", cameraID);
-	return cameraID;
+	struct arducam_mega_data *data = p1;
+	struct arducam_mega_save_msg msg;
+	struct camera_file_sink *sink;
+	int ret;
+
+	while (true) {
+		k_msgq_get(&data->save_full, &msg, K_FOREVER);
+		sink = msg.sink;
+		if (msg.length > 0 && sink->error == 0) {
+			ret = camera_file_commit(sink, msg.buff, msg.length);
+			if (ret != 0) {
+				sink->error = ret;
+			}
+		}
+		if (msg.buff != NULL) {
+			k_msgq_put(&data->save_free, &msg.buff, K_NO_WAIT);
+		}
+		if (msg.last) {
+			k_sem_give(&data->save_done);
+		}
+	}
+}
+#endif
+
+/*
+ * Writes out the collected buffer. With the writer thread the buffer is
+ * queued and the next free one is taken, blocking for up to
+ * CONFIG_ARDUCAM_MEGA_SAVE_WRITER_TIMEOUT_MS when the writer is behind. The
+ * last flush waits for the writer to drain.
+ */
+static int camera_file_flush(struct camera_file_sink *sink, bool last)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER)
+	struct arducam_mega_data *data = sink->dev->data;
+	struct arducam_mega_save_msg msg = {
+		.sink = sink,
+		.buff = sink->buff,
+		.length = sink->fill,
+		.last = last,
+	};
+
+	int ret;
+
+	/*
+	 * The queue has room for every buffer plus a last message without one,
+	 * so it is never full. The last message must get through regardless,
+	 * the writer may still be using the sink.
+	 */
+	ret = k_msgq_put(&data->save_full, &msg, last ? K_FOREVER : K_NO_WAIT);
+	if (ret != 0) {
+		LOG_ERR("%s: filesystem writer queue full", sink->dev->name);
+		return -EAGAIN;
+	}
+	sink->buff = NULL;
+	sink->fill = 0;
+	if (last) {
+		k_sem_take(&data->save_done, K_FOREVER);
+	} else if (k_msgq_get(&data->save_free, &sink->buff, ARDUCAM_MEGA_SAVE_WRITER_WAIT) != 0) {
+		LOG_ERR("%s: filesystem writer stalled", sink->dev->name);
+		return -EAGAIN;
+	}
+	return sink->error;
+#else
+	int ret = camera_file_commit(sink, sink->buff, sink->fill);
+
+	sink->fill = 0;
+	return ret;
+#endif
+}
+
+/*
+ * Collects the frame in the save buffer and writes it out one full buffer at
+ * a time. Without the writer thread, chunks at least a buffer long arriving
+ * at an empty buffer skip the copy and are written in place.
+ */
+static int camera_file_write(uint8_t *buffer, uint32_t length, void *user_data)
+{
+	struct camera_file_sink *sink = user_data;
+	uint32_t count;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_ARDUCAM_MEGA_SAVE_WRITER) && sink->fill == 0 &&
+	    length >= ARDUCAM_MEGA_SAVE_BUFFER_SIZE) {
+		count = ROUND_DOWN(length, ARDUCAM_MEGA_SAVE_BUFFER_SIZE);
+		ret = camera_file_commit(sink, buffer, count);
+		if (ret != 0) {
+			return ret;
+		}
+		buffer += count;
+		length -= count;
+	}
+	while (length > 0) {
+		count = MIN(length, ARDUCAM_MEGA_SAVE_BUFFER_SIZE - sink->fill);
+		memcpy(&sink->buff[sink->fill], buffer, count);
+		sink->fill += count;
+		buffer += count;
+		length -= count;
+		if (sink->fill == ARDUCAM_MEGA_SAVE_BUFFER_SIZE) {
+			ret = camera_file_flush(sink, false);
+			if (ret != 0) {
+				return ret;
+			}
+		}
+	}
+	return 0;
+}
+
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC) || defined(CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR)
+/*
+ * Derives a file name next to @p path with its extension replaced by @p ext,
+ * which also works with 8.3 names.
+ */
+static int camera_sibling_path(char *out, size_t size, const char *path, const char *ext)
+{
+	const char *dot = strrchr(path, '.');
+	const char *slash = strrchr(path, '/');
+	size_t stem = strlen(path);
+	int ret;
+
+	if (dot != NULL && (slash == NULL || dot > slash)) {
+		stem = dot - path;
+	}
+	ret = snprintf(out, size, "%.*s.%s", (int)stem, path, ext);
+	if (ret < 0 || ret >= size) {
+		return -ENAMETOOLONG;
+	}
+	if (strcmp(out, path) == 0) {
+		LOG_ERR("%s would overwrite itself", path);
+		return -EINVAL;
+	}
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR)
+/* Writes and syncs the metadata of the frame just read to @p meta_path */
+static int camera_save_meta(const struct device *dev, const char *meta_path)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res =
+		arducam_mega_mode_resolution(data->currentPictureMode);
+	struct arducam_mega_save_meta meta = {
+		.magic = sys_cpu_to_le32(ARDUCAM_MEGA_META_MAGIC),
+		.version = ARDUCAM_MEGA_META_VERSION,
+		.format = data->currentPixelFormat,
+		.width = sys_cpu_to_le16(res != NULL ? res->width : 0),
+		.height = sys_cpu_to_le16(res != NULL ? res->height : 0),
+		.timestamp = sys_cpu_to_le64(data->capture_time),
+		.length = sys_cpu_to_le32(data->readout.length),
+		.crc32 = sys_cpu_to_le32(data->readout.crc32),
+	};
+	struct fs_file_t file;
+	int ret, err;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	if (data->settings_valid) {
+		meta.settings_valid = 1;
+		meta.brightness = data->settings.brightness;
+		meta.contrast = data->settings.contrast;
+		meta.saturation = data->settings.saturation;
+		meta.ev = data->settings.ev;
+		meta.sharpness = data->settings.sharpness;
+		meta.color_fx = data->settings.color_fx;
+		meta.white_balance = data->settings.white_balance;
+		meta.auto_white_balance = data->settings.auto_white_balance;
+		meta.auto_exposure = data->settings.auto_exposure;
+		meta.auto_gain = data->settings.auto_gain;
+		meta.exposure = sys_cpu_to_le32(data->settings.exposure);
+		meta.gain = sys_cpu_to_le16(data->settings.gain);
+	}
+	k_mutex_unlock(&data->lock);
+
+	fs_file_t_init(&file);
+	ret = fs_open(&file, meta_path, FS_O_CREATE | FS_O_WRITE);
+	if (ret < 0) {
+		LOG_ERR("Failed to create file %s %d", meta_path, ret);
+		return ret;
+	}
+	ret = fs_truncate(&file, 0);
+	if (ret == 0) {
+		ret = fs_write(&file, &meta, sizeof(meta));
+		ret = ret == sizeof(meta) ? 0 : (ret < 0 ? ret : -ENOSPC);
+	}
+	if (ret == 0) {
+		ret = fs_sync(&file);
+	}
+	err = fs_close(&file);
+	return ret < 0 ? ret : err;
+}
+#endif
+
+/*
+ * Saves the frame to @p path, through a temporary file with
+ * CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC. The sidecar always goes through a
+ * temporary file. The previous sidecar is removed before the new image takes
+ * its name and the new one is renamed into place last, so an image is only
+ * ever next to its own metadata or none.
+ */
+static int camera_save_fifo(const struct device *dev, const char *base_path, uint32_t length,
+			    char *filename)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct camera_file_sink sink = {.dev = dev};
+	char path[MAX_PATH];
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC)
+	char temp_path[MAX_PATH];
+#endif
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR)
+	char meta_path[MAX_PATH];
+	char meta_temp[MAX_PATH];
+#endif
+	struct camera_phase phase;
+	int ret, err;
+
+	ret = snprintf(path, sizeof(path), "%s/%s", base_path, filename);
+	if (ret < 0 || ret >= sizeof(path)) {
+		LOG_ERR("Path %s/%s is too long", base_path, filename);
+		return -ENAMETOOLONG;
+	}
+	sink.path = path;
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC)
+	ret = camera_sibling_path(temp_path, sizeof(temp_path), path, "$$$");
+	if (ret < 0) {
+		return ret;
+	}
+	sink.path = temp_path;
+#endif
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR)
+	ret = camera_sibling_path(meta_path, sizeof(meta_path), path, "inf");
+	if (ret == 0) {
+		ret = camera_sibling_path(meta_temp, sizeof(meta_temp), path, "in$");
+	}
+	if (ret < 0) {
+		return ret;
+	}
+#if !defined(CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC)
+	/* The image is rewritten in place, drop the metadata of the old one first */
+	ret = fs_unlink(meta_path);
+	if (ret < 0 && ret != -ENOENT) {
+		return ret;
+	}
+#endif
+#endif
+	fs_file_t_init(&sink.file);
+	data->receivedLength = length;
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER)
+	/* Every buffer is back in the free queue between saves */
+	if (k_msgq_get(&data->save_free, &sink.buff, K_NO_WAIT) != 0) {
+		LOG_ERR("%s: no free save buffer", dev->name);
+		return -EBUSY;
+	}
+#else
+	sink.buff = data->save_buff[0];
+#endif
+
+	ret = camera_stream_fifo(dev, camera_file_write, sizeof(data->fifo_buff), &sink);
+	if (ret < 0) {
+		/* Drop the tail but let the writer finish what it was given */
+		sink.fill = 0;
+	}
+	if (IS_ENABLED(CONFIG_ARDUCAM_MEGA_SAVE_WRITER) || sink.fill > 0) {
+		/* Only the tail of the file is shorter than a buffer */
+		err = camera_file_flush(&sink, true);
+		ret = ret < 0 ? ret : err;
+	}
+	camera_phase_begin(dev, &phase);
+	if (sink.file_opened) {
+		LOG_INF("Closed file with sd_write_counts %u\n", sink.sd_write_counts);
+		err = fs_close(&sink.file);
+		ret = ret < 0 ? ret : err;
+	}
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR)
+	if (ret >= 0) {
+		ret = camera_save_meta(dev, meta_temp);
+	}
+	if (ret >= 0) {
+		ret = fs_unlink(meta_path);
+		ret = ret == -ENOENT ? 0 : ret;
+	}
+#endif
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC)
+	if (sink.file_opened) {
+		if (ret >= 0) {
+			ret = fs_rename(temp_path, path);
+		}
+		if (ret < 0) {
+			/* The previous file under the final name, if any, stays intact */
+			fs_unlink(temp_path);
+		}
+	}
+#endif
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR)
+	if (ret >= 0) {
+		ret = fs_rename(meta_temp, meta_path);
+	}
+	if (ret < 0) {
+		fs_unlink(meta_temp);
+	}
+#endif
+	camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_WRITE);
+	return ret < 0 ? ret : 0;
+}
+
+/* Every control, three automatic modes and five manual value bytes */
+#define CAMERA_SETTINGS_REGS_MAX 16
+
+/* Appends the writes that take the camera from @p cur (NULL if unknown) to @p new */
+static size_t camera_settings_regs(const struct arducam_mega_settings *cur,
+				   const struct arducam_mega_settings *new,
+				   struct arducam_mega_reg *regs)
+{
+	size_t count = 0;
+
+#define CAMERA_SETTING(field, reg)                                                                 \
+	if (cur == NULL || cur->field != new->field) {                                             \
+		regs[count++] = (struct arducam_mega_reg){reg, new->field};                        \
+	}
+	CAMERA_SETTING(brightness, CAM_REG_BRIGHTNESS_CONTROL)
+	CAMERA_SETTING(contrast, CAM_REG_CONTRAST_CONTROL)
+	CAMERA_SETTING(saturation, CAM_REG_SATURATION_CONTROL)
+	CAMERA_SETTING(ev, CAM_REG_EV_CONTROL)
+	CAMERA_SETTING(sharpness, CAM_REG_SHARPNESS_CONTROL)
+	CAMERA_SETTING(color_fx, CAM_REG_COLOR_EFFECT_CONTROL)
+	CAMERA_SETTING(autofocus, CAM_REG_AUTO_FOCUS_CONTROL)
+	CAMERA_SETTING(white_balance, CAM_REG_WHILEBALANCE_MODE_CONTROL)
+#undef CAMERA_SETTING
+
+	/* Automatic modes are switched through one register, bit 7 enables */
+	if (cur == NULL || cur->auto_white_balance != new->auto_white_balance) {
+		regs[count++] = (struct arducam_mega_reg){
+			CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL,
+			(new->auto_white_balance ? 0x80 : 0) | SET_WHILEBALANCE};
+	}
+	if (cur == NULL || cur->auto_exposure != new->auto_exposure) {
+		regs[count++] = (struct arducam_mega_reg){
+			CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL,
+			(new->auto_exposure ? 0x80 : 0) | SET_EXPOSURE};
+	}
+	if (cur == NULL || cur->auto_gain != new->auto_gain) {
+		regs[count++] = (struct arducam_mega_reg){
+			CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL,
+			(new->auto_gain ? 0x80 : 0) | SET_GAIN};
+	}
+	/* Manual values only matter, and are only written, with the automatic mode off */
+	if (!new->auto_exposure &&
+	    (cur == NULL || cur->auto_exposure || cur->exposure != new->exposure)) {
+		regs[count++] = (struct arducam_mega_reg){CAM_REG_MANUAL_EXPOSURE_BIT_19_16,
+							  (new->exposure >> 16) & 0x0f};
+		regs[count++] = (struct arducam_mega_reg){CAM_REG_MANUAL_EXPOSURE_BIT_15_8,
+							  (new->exposure >> 8) & 0xff};
+		regs[count++] = (struct arducam_mega_reg){CAM_REG_MANUAL_EXPOSURE_BIT_7_0,
+							  new->exposure & 0xff};
+	}
+	if (!new->auto_gain && (cur == NULL || cur->auto_gain || cur->gain != new->gain)) {
+		regs[count++] = (struct arducam_mega_reg){CAM_REG_MANUAL_GAIN_BIT_9_8,
+							  (new->gain >> 8) & 0x03};
+		regs[count++] = (struct arducam_mega_reg){CAM_REG_MANUAL_GAIN_BIT_7_0,
+							  new->gain & 0xff};
+	}
+	return count;
+}
+
+/*
+ * Writes every control shadowed in the data back in one batch. A sensor
+ * reset returns the controls to their power-on values, so this brings the
+ * camera back to what the application last set.
+ */
+static int camera_restore_settings(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_reg regs[CAMERA_SETTINGS_REGS_MAX];
+	size_t count;
+	int ret;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	count = camera_settings_regs(NULL, &data->settings, regs);
+	ret = camera_write_regs(dev, regs, count);
+	if (ret == 0) {
+		data->settings_valid = 1;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+/* Counts a failed capture and starts over from a reset sensor with the same controls */
+static void camera_capture_failed(const struct device *dev, int error)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	CAMERA_STATS_INC(data, frame_errors);
+	CAMERA_TRACE("arducam_mega_capture_failed", -error, 0);
+	if (camera_sensor_reset(dev) == 0) {
+		camera_restore_settings(dev);
+	}
+}
+
+/* Triggers a frame with the current sensor setup and returns its FIFO length */
+static int camera_trigger_capture(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct camera_phase phase;
+	uint8_t len1, len2, len3;
+	uint32_t length;
+	int ret;
+
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	data->profile.captures++;
+#endif
+	camera_phase_begin(dev, &phase);
+	CAMERA_TRACE("arducam_mega_capture", data->currentPictureMode, 0);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	/* Clear fifo flags */
+	ret = camera_write_reg(dev, ARDUCHIP_FIFO, FIFO_CLEAR_ID_MASK);
+	k_sem_reset(&data->capture_sem);
+	/* Start capture */
+	if (ret == 0) {
+		ret = camera_write_reg(dev, ARDUCHIP_FIFO, FIFO_START_MASK);
+	}
+	k_mutex_unlock(&data->lock);
+	data->burstFirstFlag = 0;
+	data->readout_valid = 0;
+
+	if (ret == 0) {
+		ret = camera_wait_capture(dev);
+	}
+	camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_EXPOSURE);
+	if (ret < 0) {
+		camera_capture_failed(dev, ret);
+		return ret;
+	}
+	camera_phase_begin(dev, &phase);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_read_reg(dev, FIFO_SIZE1, &len1);
+	if (ret == 0) {
+		ret = camera_read_reg(dev, FIFO_SIZE2, &len2);
+	}
+	if (ret == 0) {
+		ret = camera_read_reg(dev, FIFO_SIZE3, &len3);
+	}
+	k_mutex_unlock(&data->lock);
+	camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_LENGTH);
+	if (ret < 0) {
+		camera_capture_failed(dev, ret);
+		return ret;
+	}
+	length = ((len3 << 16) | (len2 << 8) | len1) & 0xffffff;
+	if (length == 0) {
+		LOG_ERR("%s: capture done with an empty FIFO", dev->name);
+		camera_capture_failed(dev, -EIO);
+		return -EIO;
+	}
+	data->capture_time = k_uptime_get();
+	CAMERA_STATS_INC(data, frames);
+	CAMERA_TRACE("arducam_mega_captured", length, 0);
+	LOG_DBG("Image length is %d\n", length);
+	data->totalLength = length;
+	data->receivedLength = length;
+	return length;
+}
+
+/* Programs the still capture format, skipping what is already set up */
+static int camera_set_capture_format(const struct device *dev, CAM_IMAGE_MODE mode,
+				     CAM_IMAGE_PIX_FMT pixel_format)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_reg format_regs[2];
+	struct camera_phase phase;
+	size_t count = 0;
+	int ret;
+
+	/* Only reprogram what differs from the sensor's current setup */
+	if (data->currentPixelFormat != pixel_format) {
+		/* Set pixel format */
+		format_regs[count++] = (struct arducam_mega_reg){CAM_REG_FORMAT, pixel_format};
+	}
+	if (data->currentPictureMode != mode) {
+		/* Set capture resolution */
+		format_regs[count++] = (struct arducam_mega_reg){CAM_REG_CAPTURE_RESOLUTION,
+								 CAM_SET_CAPTURE_MODE | mode};
+	}
+	camera_phase_begin(dev, &phase);
+	ret = camera_write_regs(dev, format_regs, count);
+	camera_phase_end(dev, &phase, ARDUCAM_MEGA_PHASE_CONFIG);
+	if (ret < 0) {
+		/* Part of the batch may have gone out, reprogram both next time */
+		data->currentPixelFormat = CAM_IMAGE_PIX_FMT_NONE;
+		data->currentPictureMode = CAM_IMAGE_MODE_NONE;
+		return ret;
+	}
+	data->currentPixelFormat = pixel_format;
+	data->currentPictureMode = mode;
+	return 0;
+}
+
+/*
+ * Checks the FIFO length against the frame. Raw frames must fill the FIFO,
+ * JPEG frames can't be larger than the uncompressed frame. Anything else is
+ * left over from an aborted capture or a misread length.
+ */
+static int camera_check_length(const struct device *dev, const struct arducam_mega_resolution *res,
+			       CAM_IMAGE_PIX_FMT pixel_format, uint32_t length)
+{
+	uint32_t frame_size;
+
+	if (res == NULL) {
+		return 0;
+	}
+	frame_size = res->width * res->height * ARDUCAM_MEGA_RAW_BPP;
+	if (pixel_format != CAM_IMAGE_PIX_FMT_JPG && length < frame_size) {
+		LOG_ERR("%s: FIFO holds %u of %u frame bytes", dev->name, length, frame_size);
+		return -EIO;
+	}
+	if (pixel_format == CAM_IMAGE_PIX_FMT_JPG && length > frame_size) {
+		LOG_ERR("%s: FIFO length %u too large for %ux%u JPEG", dev->name, length,
+			res->width, res->height);
+		return -EIO;
+	}
+	return 0;
+}
+
+/*
+ * Captures one frame, repeating a failed capture up to
+ * CONFIG_ARDUCAM_MEGA_CAPTURE_RETRIES times. Each failure resets the sensor,
+ * so the retry starts from the power-on state.
+ */
+static int camera_capture_image(const struct device *dev, CAM_IMAGE_MODE mode,
+				CAM_IMAGE_PIX_FMT pixel_format)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res = arducam_mega_mode_resolution(mode);
+	int length;
+	int ret;
+
+	if (pixel_format != CAM_IMAGE_PIX_FMT_JPG && pixel_format != CAM_IMAGE_PIX_FMT_RGB565 &&
+	    pixel_format != CAM_IMAGE_PIX_FMT_YUV) {
+		return -EINVAL;
+	}
+	if (pixel_format != CAM_IMAGE_PIX_FMT_JPG && res == NULL) {
+		return -EINVAL;
+	}
+
+	for (int attempt = 0;; attempt++) {
+		ret = camera_set_capture_format(dev, mode, pixel_format);
+		if (ret < 0) {
+			camera_capture_failed(dev, ret);
+		} else {
+			/* A failed trigger has already reset the sensor */
+			length = camera_trigger_capture(dev);
+			if (length < 0) {
+				ret = length;
+			} else {
+				ret = camera_check_length(dev, res, pixel_format, length);
+				if (ret < 0) {
+					camera_capture_failed(dev, ret);
+				}
+			}
+		}
+		if (ret == 0 || attempt >= CONFIG_ARDUCAM_MEGA_CAPTURE_RETRIES) {
+			break;
+		}
+		LOG_WRN("%s: capture failed %d, retrying", dev->name, ret);
+	}
+	if (ret < 0) {
+		return ret;
+	}
+	if (pixel_format != CAM_IMAGE_PIX_FMT_JPG) {
+		/* Raw frames have a known size, read exactly that much */
+		length = res->width * res->height * ARDUCAM_MEGA_RAW_BPP;
+		data->totalLength = length;
+		data->receivedLength = length;
+	}
+	LOG_INF("Image length is %d\n", length);
+	return length;
+}
+
+int arducam_mega_capture_image(const struct device *dev, CAM_IMAGE_MODE mode,
+			       CAM_IMAGE_PIX_FMT pixel_format)
+{
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	ret = camera_capture_image(dev, mode, pixel_format);
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+/*
+ * Reads @p lines lines of the raw frame into @p buffer, one line every
+ * @p pitch bytes, and folds them into @p crc. Each burst goes straight into
+ * the destination line.
+ */
+static int camera_read_lines(const struct device *dev, uint8_t *buffer, uint32_t line,
+			     uint32_t pitch, uint16_t lines, uint32_t *crc)
+{
+	int count;
+
+	for (uint16_t i = 0; i < lines; i++) {
+		for (uint32_t pos = 0; pos < line; pos += count) {
+			count = camera_read_fifo(dev, &buffer[pos],
+						 MIN(line - pos, ARDUCAM_MEGA_FIFO_CHUNK_SIZE));
+			if (count <= 0) {
+				return count < 0 ? count : -EIO;
+			}
+		}
+		*crc = camera_crc_update(*crc, buffer, line);
+		buffer += pitch;
+	}
+	return 0;
+}
+
+static int camera_read_frame(const struct device *dev, uint8_t *buffer, uint32_t pitch)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res =
+		arducam_mega_mode_resolution(data->currentPictureMode);
+	uint32_t line;
+	uint32_t crc = 0;
+	int ret;
+
+	if (data->currentPixelFormat == CAM_IMAGE_PIX_FMT_JPG || res == NULL) {
+		return -ENOTSUP;
+	}
+	line = res->width * ARDUCAM_MEGA_RAW_BPP;
+	if (pitch == 0) {
+		pitch = line;
+	}
+	if (pitch < line) {
+		return -EINVAL;
+	}
+	ret = camera_read_lines(dev, buffer, line, pitch, res->height, &crc);
+	if (ret < 0) {
+		return ret;
+	}
+	camera_readout_done(data, line * res->height, crc);
+	return 0;
+}
+
+int arducam_mega_read_frame(const struct device *dev, uint8_t *buffer, uint32_t pitch)
+{
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	ret = camera_read_frame(dev, buffer, pitch);
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+static int camera_stream_lines(const struct device *dev, BUFFER_CALLBACK function,
+			       void *user_data)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res =
+		arducam_mega_mode_resolution(data->currentPictureMode);
+	uint32_t line;
+	uint32_t crc = 0;
+	uint16_t batch;
+	int ret;
+
+	if (data->currentPixelFormat == CAM_IMAGE_PIX_FMT_JPG || res == NULL) {
+		return -ENOTSUP;
+	}
+	line = res->width * ARDUCAM_MEGA_RAW_BPP;
+	if (line > sizeof(data->fifo_buff)) {
+		return -ENOSPC;
+	}
+	/* Read as many whole lines per burst as the readout buffer holds */
+	batch = sizeof(data->fifo_buff) / line;
+	for (uint16_t y = 0; y < res->height; y += batch) {
+		batch = MIN(batch, res->height - y);
+		ret = camera_read_lines(dev, data->fifo_buff, line, line, batch, &crc);
+		if (ret < 0) {
+			return ret;
+		}
+		for (uint16_t i = 0; i < batch; i++) {
+			ret = function(&data->fifo_buff[i * line], line, user_data);
+			if (ret != 0) {
+				return ret;
+			}
+		}
+	}
+	camera_readout_done(data, line * res->height, crc);
+	return 0;
+}
+
+int arducam_mega_stream_lines(const struct device *dev, BUFFER_CALLBACK function,
+			      void *user_data)
+{
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	ret = camera_stream_lines(dev, function, user_data);
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+int arducam_mega_save_image(const struct device *dev, char *filename, const char *mount_point,
+			    int image_length)
+{
+	return arducam_mega_save_image_readout(dev, filename, mount_point, image_length, NULL);
+}
+
+int arducam_mega_save_image_readout(const struct device *dev, char *filename,
+				    const char *mount_point, int image_length,
+				    struct arducam_mega_readout *readout)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+
+	LOG_INF("Saving image\n");
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	ret = camera_save_fifo(dev, mount_point, image_length, filename);
+	if (ret == 0 && readout != NULL) {
+		*readout = data->readout;
+	}
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+int arducam_mega_register_callback(const struct device *dev, BUFFER_CALLBACK function,
+				   uint32_t block_size, void *user_data)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	if (block_size == 0 || block_size > sizeof(data->fifo_buff)) {
+		block_size = sizeof(data->fifo_buff);
+	}
+	data->callBackFunction = function;
+	data->blockSize = block_size;
+	data->user_data = user_data;
+	return 0;
+}
+
+int arducam_mega_stream_image(const struct device *dev, int image_length)
+{
+	return arducam_mega_stream_image_readout(dev, image_length, NULL);
+}
+
+int arducam_mega_stream_image_readout(const struct device *dev, int image_length,
+				      struct arducam_mega_readout *readout)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+
+	if (data->callBackFunction == NULL) {
+		return -EINVAL;
+	}
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	data->receivedLength = image_length;
+	ret = camera_stream_fifo(dev, data->callBackFunction, data->blockSize, data->user_data);
+	if (ret >= 0 && readout != NULL) {
+		*readout = data->readout;
+	}
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+#if defined(CONFIG_ARDUCAM_MEGA_ASYNC)
+int arducam_mega_stream_image_async(const struct device *dev, int image_length,
+				    struct k_poll_signal *signal)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+
+	if (data->callBackFunction == NULL || image_length <= 0) {
+		return -EINVAL;
+	}
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	if (data->previewMode) {
+		/* The video work item would read the FIFO under the transfer */
+		camera_capture_unlock(dev);
+		return -EBUSY;
+	}
+	atomic_set(&data->async_busy, 1);
+
+	data->async_stream = (struct arducam_mega_stream){
+		.function = data->callBackFunction,
+		.user_data = data->user_data,
+		.raw = data->currentPixelFormat != CAM_IMAGE_PIX_FMT_JPG,
+	};
+	arducam_mega_jpeg_scan_init(&data->async_stream.scanner);
+	data->async_signal = signal;
+	data->async_result = 0;
+	data->async_start = k_uptime_get();
+	data->receivedLength = image_length;
+
+	ret = camera_burst_read_async(dev, 0, data->blockSize);
+	if (ret < 0) {
+		LOG_ERR("Asynchronous FIFO read failed %d", ret);
+		atomic_set(&data->async_busy, 0);
+	}
+	camera_capture_unlock(dev);
+	return ret;
+}
+#endif
+
+int arducam_mega_get_readout(const struct device *dev, struct arducam_mega_readout *readout)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	if (data->readout_valid) {
+		*readout = data->readout;
+	} else {
+		ret = -ENODATA;
+	}
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+int arducam_mega_get_stream_stats(const struct device *dev,
+				  struct arducam_mega_stream_stats *stats)
+{
+	struct arducam_mega_data *data = dev->data;
+	/* A stopped stream keeps the rate it ended with */
+	int64_t end = data->previewMode ? k_uptime_get() : data->stream_stop;
+	int64_t elapsed = MAX(end - data->stream_start, 1);
+
+	stats->frames = data->stream_frames;
+	stats->dropped = data->stream_dropped;
+	stats->elapsed_ms = elapsed;
+	stats->fps_x100 = (uint64_t)data->stream_frames * 100 * MSEC_PER_SEC / elapsed;
+	return 0;
+}
+
+int arducam_mega_get_profile(const struct device *dev, struct arducam_mega_profile *profile)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	struct arducam_mega_data *data = dev->data;
+
+	*profile = data->profile;
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+void arducam_mega_reset_profile(const struct device *dev)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	struct arducam_mega_data *data = dev->data;
+
+	memset(&data->profile, 0, sizeof(data->profile));
+#endif
+}
+
+void arducam_mega_print_profile(const struct device *dev, const char *tag)
+{
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	static const char *const phase_names[ARDUCAM_MEGA_PHASE_COUNT] = {
+		"reset", "config", "exposure", "length", "readout", "write",
+	};
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_profile *profile = &data->profile;
+
+	for (int i = 0; i < ARDUCAM_MEGA_PHASE_COUNT; i++) {
+		printk("arducam_mega_profile,%s,%s,%s,%u,%llu,%llu,%u\n", dev->name, tag,
+		       phase_names[i], profile->captures, profile->cycles[i],
+		       k_cyc_to_us_floor64(profile->cycles[i]), profile->transactions[i]);
+	}
+#endif
+}
+
+uint32_t arducam_mega_get_resume_latency(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	return data->resume_us;
+}
+
+int arducam_mega_read_buffer(const struct device *dev, uint8_t *buffer, uint32_t length)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	/* A partial read moves the FIFO on, the last readout no longer matches it */
+	data->readout_valid = 0;
+	ret = camera_read_fifo(dev, buffer, length);
+	camera_capture_unlock(dev);
+	return ret;
+}
+
+#if defined(CONFIG_ARDUCAM_MEGA_FRAME_POOL)
+/* Every block starts with the descriptor, which holds a 64-bit timestamp */
+#define FRAME_BLOCK_ALIGN __alignof__(struct arducam_mega_frame)
+#define FRAME_BLOCK_SIZE                                                                           \
+	ROUND_UP(sizeof(struct arducam_mega_frame) + CONFIG_ARDUCAM_MEGA_FRAME_SIZE,               \
+		 FRAME_BLOCK_ALIGN)
+
+K_MEM_SLAB_DEFINE_STATIC(frame_slab, FRAME_BLOCK_SIZE, CONFIG_ARDUCAM_MEGA_FRAME_POOL_COUNT,
+			 FRAME_BLOCK_ALIGN);
+
+struct arducam_mega_frame *arducam_mega_frame_alloc(k_timeout_t timeout)
+{
+	struct arducam_mega_frame *frame;
+
+	if (k_mem_slab_alloc(&frame_slab, (void **)&frame, timeout) != 0) {
+		return NULL;
+	}
+	/* The frame contents follow the descriptor in the same block */
+	*frame = (struct arducam_mega_frame){
+		.data = (uint8_t *)(frame + 1),
+		.size = CONFIG_ARDUCAM_MEGA_FRAME_SIZE,
+		.refcount = ATOMIC_INIT(1),
+	};
+	return frame;
+}
+
+void arducam_mega_frame_ref(struct arducam_mega_frame *frame)
+{
+	atomic_inc(&frame->refcount);
+}
+
+void arducam_mega_frame_unref(struct arducam_mega_frame *frame)
+{
+	if (atomic_dec(&frame->refcount) == 1) {
+		k_mem_slab_free(&frame_slab, frame);
+	}
+}
+
+/* Narrows @p frame to bytes @p start to @p end of its data, keeping size in step */
+static void camera_frame_trim(struct arducam_mega_frame *frame, size_t start, size_t end)
+{
+	frame->data += start;
+	frame->size -= start;
+	frame->length = end - start;
+}
+
+static int camera_capture_frame(const struct device *dev, CAM_IMAGE_MODE mode,
+				CAM_IMAGE_PIX_FMT pixel_format, struct arducam_mega_frame **frame,
+				k_timeout_t timeout)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res = arducam_mega_mode_resolution(mode);
+	struct arducam_mega_frame *new_frame;
+	int length;
+
+	if (res == NULL) {
+		return -EINVAL;
+	}
+
+	new_frame = arducam_mega_frame_alloc(timeout);
+	if (new_frame == NULL) {
+		return -ENOMEM;
+	}
+
+	length = arducam_mega_capture_image(dev, mode, pixel_format);
+	if (length < 0) {
+		arducam_mega_frame_unref(new_frame);
+		return length;
+	}
+	if (length > new_frame->size) {
+		LOG_ERR("%s: frame of %d bytes exceeds pool buffer of %u bytes", dev->name, length,
+			new_frame->size);
+		arducam_mega_frame_unref(new_frame);
+		return -ENOSPC;
+	}
+
+	new_frame->timestamp = k_uptime_get();
+	length = camera_read_fifo(dev, new_frame->data, length);
+	if (length < 0) {
+		arducam_mega_frame_unref(new_frame);
+		return length;
+	}
+	new_frame->length = length;
+	if (data->currentPixelFormat == CAM_IMAGE_PIX_FMT_JPG) {
+		size_t start, end;
+
+		/* Trim FIFO padding around the JPEG in place */
+		if (arducam_mega_jpeg_find_frame(new_frame->data, new_frame->length, &start,
+						 &end) != 0) {
+			LOG_ERR("%s: no complete JPEG frame in the FIFO", dev->name);
+			arducam_mega_frame_unref(new_frame);
+			return -EBADMSG;
+		}
+		camera_frame_trim(new_frame, start, end);
+	}
+	camera_readout_done(data, new_frame->length,
+			    camera_crc_update(0, new_frame->data, new_frame->length));
+	new_frame->format = data->currentPixelFormat;
+	new_frame->mode = mode;
+	new_frame->width = res->width;
+	new_frame->height = res->height;
+	new_frame->sequence = data->frame_sequence++;
+	*frame = new_frame;
+	return 0;
+}
+
+int arducam_mega_capture_frame(const struct device *dev, CAM_IMAGE_MODE mode,
+			       CAM_IMAGE_PIX_FMT pixel_format, struct arducam_mega_frame **frame,
+			       k_timeout_t timeout)
+{
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	ret = camera_capture_frame(dev, mode, pixel_format, frame, timeout);
+	camera_capture_unlock(dev);
+	return ret;
+}
+/*
+ * Splits the JPEG frames of a burst out of the FIFO. Each frame buffer
+ * receives everything from the end of the previous frame up to its EOI and
+ * is then trimmed to its SOI, so padding between frames is dropped.
+ */
+static int camera_split_burst(const struct device *dev, struct arducam_mega_frame **frames,
+			      uint8_t count)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_jpeg_scanner scanner;
+	struct arducam_mega_frame *frame;
+	uint8_t done = 0;
+	int length = 0;
+	uint32_t pos = 0;
+	size_t used;
+	int status;
+
+	arducam_mega_jpeg_scan_init(&scanner);
+	while (done < count) {
+		frame = frames[done];
+		if (pos == length) {
+			length = camera_read_fifo(dev, data->fifo_buff, sizeof(data->fifo_buff));
+			pos = 0;
+			if (length < 0) {
+				return length;
+			}
+			if (length == 0) {
+				break;
+			}
+		}
+		status = arducam_mega_jpeg_scan(&scanner, &data->fifo_buff[pos], length - pos,
+						&used);
+		if (status < 0) {
+			LOG_ERR("%s: malformed JPEG in burst frame %u", dev->name, done);
+			return status;
+		}
+		if (frame->length + used > frame->size) {
+			LOG_ERR("%s: burst frame %u exceeds pool buffer of %u bytes", dev->name,
+				done, frame->size);
+			return -ENOSPC;
+		}
+		memcpy(&frame->data[frame->length], &data->fifo_buff[pos], used);
+		frame->length += used;
+		pos += used;
+		if (status == ARDUCAM_MEGA_JPEG_COMPLETE) {
+			camera_frame_trim(frame, scanner.soi, scanner.end);
+			arducam_mega_jpeg_scan_init(&scanner);
+			done++;
+		}
+	}
+	return done;
+}
+
+static int camera_capture_burst(const struct device *dev, CAM_IMAGE_MODE mode,
+				struct arducam_mega_frame **frames, uint8_t count,
+				k_timeout_t timeout)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res = arducam_mega_mode_resolution(mode);
+	const struct arducam_mega_reg frames_reg[] = {
+		{ARDUCHIP_FRAMES, count - 1},
+	};
+	const struct arducam_mega_reg single_reg[] = {
+		{ARDUCHIP_FRAMES, 0},
+	};
+	int64_t start, elapsed;
+	int ret;
+
+	if (res == NULL || count == 0) {
+		return -EINVAL;
+	}
+	for (int i = 0; i < count; i++) {
+		frames[i] = arducam_mega_frame_alloc(timeout);
+		if (frames[i] == NULL) {
+			ret = -ENOMEM;
+			count = i;
+			goto release;
+		}
+	}
+
+	ret = camera_set_capture_format(dev, mode, CAM_IMAGE_PIX_FMT_JPG);
+	if (ret == 0) {
+		ret = camera_write_regs(dev, frames_reg, ARRAY_SIZE(frames_reg));
+	}
+	if (ret < 0) {
+		camera_capture_failed(dev, ret);
+		goto release;
+	}
+	start = k_uptime_get();
+	ret = camera_trigger_capture(dev);
+	elapsed = k_uptime_get() - start;
+	if (camera_write_regs(dev, single_reg, ARRAY_SIZE(single_reg)) < 0 && ret >= 0) {
+		/* Later captures would each fill the FIFO with a burst */
+		ret = -EIO;
+		camera_capture_failed(dev, ret);
+	}
+	if (ret < 0) {
+		goto release;
+	}
+	LOG_INF("%s: burst of %u frames, %d bytes", dev->name, count, ret);
+
+	ret = camera_split_burst(dev, frames, count);
+	if (ret < 0) {
+		goto release;
+	}
+	if (ret < count) {
+		LOG_WRN("%s: only %d of %u burst frames in the FIFO", dev->name, ret, count);
+	}
+	for (int i = 0; i < ret; i++) {
+		/* The camera only reports the end of the burst, spread it over the frames */
+		frames[i]->timestamp = start + elapsed * (i + 1) / count;
+		frames[i]->format = CAM_IMAGE_PIX_FMT_JPG;
+		frames[i]->mode = mode;
+		frames[i]->width = res->width;
+		frames[i]->height = res->height;
+		frames[i]->sequence = data->frame_sequence++;
+	}
+	for (int i = ret; i < count; i++) {
+		arducam_mega_frame_unref(frames[i]);
+		frames[i] = NULL;
+	}
+	return ret;
+
+release:
+	for (int i = 0; i < count; i++) {
+		arducam_mega_frame_unref(frames[i]);
+		frames[i] = NULL;
+	}
+	return ret;
 }
-int arducam_mega_init()
+
+int arducam_mega_capture_burst(const struct device *dev, CAM_IMAGE_MODE mode,
+			       struct arducam_mega_frame **frames, uint8_t count,
+			       k_timeout_t timeout)
 {
-	int ret = gpio_pin_configure_dt(&spec, GPIO_OUTPUT_ACTIVE);
+	int ret;
+
+	ret = camera_capture_lock(dev);
 	if (ret < 0) {
-		LOG_ERR("Couldn't configure CS pin");
-		return -1;
+		return ret;
 	}
+	ret = camera_capture_burst(dev, mode, frames, count, timeout);
+	camera_capture_unlock(dev);
+	return ret;
+}
+#endif /* CONFIG_ARDUCAM_MEGA_FRAME_POOL */
 
-	LOG_INF("Initializing the camera");
-	spi = device_get_binding(SPI_DEV_NAME);
-	if (!device_is_ready(spi)) {
-		LOG_ERR("Device SPI not ready, aborting test");
-		return -1;
+int arducam_mega_get_id(const struct device *dev)
+{
+	uint8_t cameraID;
+	int ret;
+
+	ret = camera_read_reg(dev, CAM_REG_SENSOR_ID, &cameraID);
+	if (ret < 0) {
+		return ret;
 	}
-	return 0;
+	LOG_INF("Sensor camera ID is %x\n", cameraID);
+	return cameraID;
 }
 CAM_IMAGE_MODE arducam_mega_get_resolution(char *resolution)
 {
@@ -374,34 +2119,776 @@ CAM_CONTRAST_LEVEL arducam_mega_get_contrast(char *contrast)
 	return CAM_CONTRAST_LEVEL_DEFAULT;
 }
 
-int arducam_mega_set_saturation(CAM_SATURATION_LEVEL saturation)
+void arducam_mega_default_settings(struct arducam_mega_settings *settings)
+{
+	*settings = (struct arducam_mega_settings){
+		.brightness = CAM_BRIGHTNESS_LEVEL_DEFAULT,
+		.contrast = CAM_CONTRAST_LEVEL_DEFAULT,
+		.saturation = CAM_SATURATION_LEVEL_DEFAULT,
+		.ev = CAM_EV_LEVEL_DEFAULT,
+		.sharpness = CAM_SHARPNESS_LEVEL_AUTO,
+		.color_fx = CAM_COLOR_FX_NONE,
+		.autofocus = CAM_AUTO_FOCUS_DEFAULT,
+		.white_balance = CAM_WHITE_BALANCE_MODE_DEFAULT,
+		.auto_white_balance = 1,
+		.auto_exposure = 1,
+		.auto_gain = 1,
+	};
+}
+
+int arducam_mega_apply_settings(const struct device *dev,
+				const struct arducam_mega_settings *settings)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_reg regs[CAMERA_SETTINGS_REGS_MAX];
+	size_t count;
+	int ret;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	count = camera_settings_regs(data->settings_valid ? &data->settings : NULL, settings,
+				     regs);
+	LOG_DBG("%s: applying settings in %zu writes", dev->name, count);
+	ret = camera_write_regs(dev, regs, count);
+	if (ret == 0) {
+		data->settings = *settings;
+		data->settings_valid = 1;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_get_settings(const struct device *dev, struct arducam_mega_settings *settings)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret = 0;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	if (data->settings_valid) {
+		*settings = data->settings;
+	} else {
+		ret = -ENODATA;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_saturation(const struct device *dev, CAM_SATURATION_LEVEL saturation)
 {
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_SATURATION_CONTROL, saturation},
+	};
+	int ret;
+
 	LOG_INF("Setting saturation to %d", saturation);
-	camera_write_reg(CAM_REG_SATURATION_CONTROL, saturation);
-	camera_wait_idle();
-	return 0;
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.saturation = saturation;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
 }
 
-int arducam_mega_set_autofocus(CAM_AUTO_FOCUS autofocus)
+int arducam_mega_set_autofocus(const struct device *dev, CAM_AUTO_FOCUS autofocus)
 {
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_AUTO_FOCUS_CONTROL, autofocus},
+	};
+	int ret;
+
 	LOG_INF("Setting autofocus to %d", autofocus);
-	camera_write_reg(CAM_REG_AUTO_FOCUS_CONTROL, autofocus);
-	camera_wait_idle();
-	return 0;
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.autofocus = autofocus;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
 }
 
-int arducam_mega_set_contrast(CAM_CONTRAST_LEVEL contrast)
+int arducam_mega_set_contrast(const struct device *dev, CAM_CONTRAST_LEVEL contrast)
 {
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_CONTRAST_CONTROL, contrast},
+	};
+	int ret;
+
 	LOG_INF("Setting contrast to %d", contrast);
-	camera_write_reg(CAM_REG_CONTRAST_CONTROL, contrast);
-	camera_wait_idle();
-	return 0;
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.contrast = contrast;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
 }
 
-int arducam_mega_set_brightness(CAM_BRIGHTNESS_LEVEL brightness)
+int arducam_mega_set_brightness(const struct device *dev, CAM_BRIGHTNESS_LEVEL brightness)
 {
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_BRIGHTNESS_CONTROL, brightness},
+	};
+	int ret;
+
 	LOG_INF("Setting brightness to %d", brightness);
-	camera_write_reg(CAM_REG_BRIGHTNESS_CONTROL, brightness);
-	camera_wait_idle();
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.brightness = brightness;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_ev(const struct device *dev, CAM_EV_LEVEL ev)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_EV_CONTROL, ev},
+	};
+	int ret;
+
+	LOG_INF("Setting EV to %d", ev);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.ev = ev;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_sharpness(const struct device *dev, CAM_SHARPNESS_LEVEL sharpness)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_SHARPNESS_CONTROL, sharpness},
+	};
+	int ret;
+
+	LOG_INF("Setting sharpness to %d", sharpness);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.sharpness = sharpness;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_color_fx(const struct device *dev, CAM_COLOR_FX color_fx)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_COLOR_EFFECT_CONTROL, color_fx},
+	};
+	int ret;
+
+	LOG_INF("Setting color effect to %d", color_fx);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.color_fx = color_fx;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_white_balance(const struct device *dev, CAM_WHITE_BALANCE white_balance)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_WHILEBALANCE_MODE_CONTROL, white_balance},
+	};
+	int ret;
+
+	LOG_INF("Setting white balance mode to %d", white_balance);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.white_balance = white_balance;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_auto_white_balance(const struct device *dev, bool enable)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL,
+		 (enable ? 0x80 : 0) | SET_WHILEBALANCE},
+	};
+	int ret;
+
+	LOG_INF("Setting auto white balance to %d", enable);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.auto_white_balance = enable;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_auto_exposure(const struct device *dev, bool enable)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL, (enable ? 0x80 : 0) | SET_EXPOSURE},
+	};
+	int ret;
+
+	LOG_INF("Setting auto exposure to %d", enable);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.auto_exposure = enable;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_exposure(const struct device *dev, uint32_t exposure)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL, SET_EXPOSURE},
+		{CAM_REG_MANUAL_EXPOSURE_BIT_19_16, (exposure >> 16) & 0x0f},
+		{CAM_REG_MANUAL_EXPOSURE_BIT_15_8, (exposure >> 8) & 0xff},
+		{CAM_REG_MANUAL_EXPOSURE_BIT_7_0, exposure & 0xff},
+	};
+	int ret;
+
+	LOG_INF("Setting exposure to %u", exposure);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.auto_exposure = 0;
+		data->settings.exposure = exposure;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_auto_gain(const struct device *dev, bool enable)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL, (enable ? 0x80 : 0) | SET_GAIN},
+	};
+	int ret;
+
+	LOG_INF("Setting auto gain to %d", enable);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.auto_gain = enable;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+int arducam_mega_set_gain(const struct device *dev, uint16_t gain)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg regs[] = {
+		{CAM_REG_EXPOSURE_GAIN_WHILEBALANCE_CONTROL, SET_GAIN},
+		{CAM_REG_MANUAL_GAIN_BIT_9_8, (gain >> 8) & 0x03},
+		{CAM_REG_MANUAL_GAIN_BIT_7_0, gain & 0xff},
+	};
+	int ret;
+
+	LOG_INF("Setting gain to %u", gain);
+	k_mutex_lock(&data->lock, K_FOREVER);
+	ret = camera_write_regs(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->settings.auto_gain = 0;
+		data->settings.gain = gain;
+	}
+	k_mutex_unlock(&data->lock);
+	return ret;
+}
+
+static const struct arducam_mega_resolution *arducam_mega_find_resolution(uint32_t width,
+									  uint32_t height)
+{
+	for (int i = 0; i < ARRAY_SIZE(resolutions); i++) {
+		if (resolutions[i].width == width && resolutions[i].height == height) {
+			return &resolutions[i];
+		}
+	}
+	return NULL;
+}
+
+static int arducam_mega_set_fmt(const struct device *dev, enum video_endpoint_id ep,
+				struct video_format *fmt)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_resolution *res;
+	uint8_t pixel_format;
+	int i;
+
+	for (i = 0; fmts[i].pixelformat != 0; i++) {
+		if (fmts[i].pixelformat == fmt->pixelformat && fmts[i].width_min == fmt->width &&
+		    fmts[i].height_min == fmt->height) {
+			break;
+		}
+	}
+	if (fmts[i].pixelformat == 0) {
+		LOG_ERR("%s: unsupported format %ux%u", dev->name, fmt->width, fmt->height);
+		return -ENOTSUP;
+	}
+	res = arducam_mega_find_resolution(fmt->width, fmt->height);
+
+	if (fmt->pixelformat == VIDEO_PIX_FMT_RGB565X) {
+		pixel_format = CAM_IMAGE_PIX_FMT_RGB565;
+	} else if (fmt->pixelformat == VIDEO_PIX_FMT_YUYV) {
+		pixel_format = CAM_IMAGE_PIX_FMT_YUV;
+	} else {
+		pixel_format = CAM_IMAGE_PIX_FMT_JPG;
+	}
+	k_mutex_lock(&data->capture_lock, K_FOREVER);
+	data->fmt = *fmt;
+	data->fmt.pitch =
+		pixel_format == CAM_IMAGE_PIX_FMT_JPG ? 0 : res->width * ARDUCAM_MEGA_RAW_BPP;
+	data->cameraDataFormat = pixel_format;
+	k_mutex_unlock(&data->capture_lock);
+	return 0;
+}
+
+static int arducam_mega_get_fmt(const struct device *dev, enum video_endpoint_id ep,
+				struct video_format *fmt)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	*fmt = data->fmt;
+	return 0;
+}
+
+static int arducam_mega_get_caps(const struct device *dev, enum video_endpoint_id ep,
+				 struct video_caps *caps)
+{
+	caps->format_caps = fmts;
+	caps->min_vbuf_count = 1;
+	return 0;
+}
+
+/* Puts the sensor in the video mode selected at stream start */
+static int camera_set_video_mode(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_reg regs[2];
+	size_t count = 0;
+	int ret;
+
+	if (data->currentPixelFormat != CAM_IMAGE_PIX_FMT_JPG) {
+		regs[count++] = (struct arducam_mega_reg){CAM_REG_FORMAT, CAM_IMAGE_PIX_FMT_JPG};
+	}
+	regs[count++] = (struct arducam_mega_reg){CAM_REG_CAPTURE_RESOLUTION,
+						  CAM_SET_VIDEO_MODE | data->video_mode};
+	ret = camera_write_regs(dev, regs, count);
+	if (ret < 0) {
+		data->currentPixelFormat = CAM_IMAGE_PIX_FMT_NONE;
+		data->currentPictureMode = CAM_IMAGE_MODE_NONE;
+		return ret;
+	}
+	data->currentPixelFormat = CAM_IMAGE_PIX_FMT_JPG;
+	/* Makes the next still capture reprogram the resolution */
+	data->currentPictureMode = CAM_SET_VIDEO_MODE | data->video_mode;
+	return 0;
+}
+
+static void arducam_mega_buffer_work(struct k_work *work)
+{
+	struct arducam_mega_data *data = CONTAINER_OF(work, struct arducam_mega_data, buf_work);
+	const struct device *dev = data->dev;
+	const struct arducam_mega_resolution *res;
+	struct video_buffer *vbuf;
+	int length;
+
+	if (!data->previewMode) {
+		return;
+	}
+	/* Without a queued buffer stay idle, arducam_mega_enqueue() submits the work again */
+	vbuf = k_fifo_get(&data->fifo_in, K_NO_WAIT);
+	if (vbuf == NULL) {
+		return;
+	}
+
+	/* Other captures get in between two frames, register updates anytime */
+	k_mutex_lock(&data->capture_lock, K_FOREVER);
+	if (data->video_mode != 0) {
+		/* The sensor stays in video mode, only the FIFO is re-armed */
+		length = 0;
+		if (data->currentPictureMode != (CAM_SET_VIDEO_MODE | data->video_mode)) {
+			/* A failed frame reset the sensor out of video mode */
+			length = camera_set_video_mode(dev);
+		}
+		if (length == 0) {
+			length = camera_trigger_capture(dev);
+		}
+	} else {
+		res = arducam_mega_find_resolution(data->fmt.width, data->fmt.height);
+		length = arducam_mega_capture_image(dev, res->mode, data->cameraDataFormat);
+	}
+
+	if (length < 0) {
+		vbuf->bytesused = 0;
+		k_fifo_put(&data->fifo_out, vbuf);
+	} else if (length > vbuf->size) {
+		LOG_ERR("%s: frame of %d bytes exceeds buffer of %u bytes", dev->name, length,
+			vbuf->size);
+		data->stream_dropped++;
+		vbuf->bytesused = 0;
+		k_fifo_put(&data->fifo_out, vbuf);
+	} else {
+		/* Read the frame straight into the application buffer */
+		length = camera_read_fifo(dev, vbuf->buffer, length);
+		vbuf->bytesused = MAX(length, 0);
+		vbuf->timestamp = k_uptime_get_32();
+		if (length > 0) {
+			data->stream_frames++;
+		}
+		k_fifo_put(&data->fifo_out, vbuf);
+	}
+	k_mutex_unlock(&data->capture_lock);
+
+	if (data->previewMode) {
+		k_work_submit_to_queue(&data->workq, &data->buf_work);
+	}
+}
+
+/* Maps the selected format onto a CAM_VIDEO_MODE, 0 if it has none */
+static uint8_t arducam_mega_video_mode(const struct video_format *fmt)
+{
+	if (fmt->pixelformat != VIDEO_PIX_FMT_JPEG) {
+		return 0;
+	} else if (fmt->width == 320 && fmt->height == 240) {
+		return CAM_VIDEO_MODE_0;
+	} else if (fmt->width == 640 && fmt->height == 480) {
+		return CAM_VIDEO_MODE_1;
+	}
+	return 0;
+}
+
+static int arducam_mega_stream_start(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	data->video_mode = arducam_mega_video_mode(&data->fmt);
+	if (data->video_mode != 0) {
+		ret = camera_set_video_mode(dev);
+		if (ret < 0) {
+			camera_capture_unlock(dev);
+			return ret;
+		}
+	}
+
+	data->stream_frames = 0;
+	data->stream_dropped = 0;
+	data->stream_start = k_uptime_get();
+	data->previewMode = 1;
+	camera_capture_unlock(dev);
+	k_work_submit_to_queue(&data->workq, &data->buf_work);
+	return 0;
+}
+
+static int arducam_mega_stream_stop(const struct device *dev)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct arducam_mega_stream_stats stats;
+	struct k_work_sync sync;
+
+	data->previewMode = 0;
+	k_work_cancel_sync(&data->buf_work, &sync);
+	data->stream_stop = k_uptime_get();
+
+	arducam_mega_get_stream_stats(dev, &stats);
+	LOG_INF("%s: streamed %u frames in %u ms (%u.%02u fps), %u dropped", dev->name,
+		stats.frames, stats.elapsed_ms, stats.fps_x100 / 100, stats.fps_x100 % 100,
+		stats.dropped);
+	return 0;
+}
+
+static int arducam_mega_enqueue(const struct device *dev, enum video_endpoint_id ep,
+				struct video_buffer *vbuf)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	k_fifo_put(&data->fifo_in, vbuf);
+	if (data->previewMode) {
+		k_work_submit_to_queue(&data->workq, &data->buf_work);
+	}
+	return 0;
+}
+
+static int arducam_mega_dequeue(const struct device *dev, enum video_endpoint_id ep,
+				struct video_buffer **vbuf, k_timeout_t timeout)
+{
+	struct arducam_mega_data *data = dev->data;
+
+	*vbuf = k_fifo_get(&data->fifo_out, timeout);
+	if (*vbuf == NULL) {
+		return -EAGAIN;
+	}
+	return 0;
+}
+
+static int arducam_mega_flush(const struct device *dev, enum video_endpoint_id ep, bool cancel)
+{
+	struct arducam_mega_data *data = dev->data;
+	struct video_buffer *vbuf;
+
+	if (cancel) {
+		arducam_mega_stream_stop(dev);
+		/* Hand back pending buffers without filling them */
+		while ((vbuf = k_fifo_get(&data->fifo_in, K_NO_WAIT)) != NULL) {
+			vbuf->bytesused = 0;
+			k_fifo_put(&data->fifo_out, vbuf);
+		}
+	} else {
+		while (!k_fifo_is_empty(&data->fifo_in)) {
+			k_sleep(K_MSEC(1));
+		}
+	}
 	return 0;
 }
+
+static int arducam_mega_set_ctrl(const struct device *dev, unsigned int cid, void *value)
+{
+	int level = (int)(intptr_t)value;
+
+	switch (cid) {
+	case VIDEO_CID_CAMERA_BRIGHTNESS:
+		return arducam_mega_set_brightness(dev, level);
+	case VIDEO_CID_CAMERA_CONTRAST:
+		return arducam_mega_set_contrast(dev, level);
+	case VIDEO_CID_CAMERA_SATURATION:
+		return arducam_mega_set_saturation(dev, level);
+	case VIDEO_CID_CAMERA_WHITE_BAL:
+		return arducam_mega_set_white_balance(dev, level);
+	case VIDEO_CID_CAMERA_EXPOSURE:
+		return arducam_mega_set_exposure(dev, level);
+	case VIDEO_CID_CAMERA_GAIN:
+		return arducam_mega_set_gain(dev, level);
+	default:
+		return -ENOTSUP;
+	}
+}
+
+static const struct video_driver_api arducam_mega_driver_api = {
+	.set_format = arducam_mega_set_fmt,
+	.get_format = arducam_mega_get_fmt,
+	.get_caps = arducam_mega_get_caps,
+	.stream_start = arducam_mega_stream_start,
+	.stream_stop = arducam_mega_stream_stop,
+	.enqueue = arducam_mega_enqueue,
+	.dequeue = arducam_mega_dequeue,
+	.flush = arducam_mega_flush,
+	.set_ctrl = arducam_mega_set_ctrl,
+};
+
+#if defined(CONFIG_ARDUCAM_MEGA_FIFO_PROBE)
+/*
+ * Lowers the FIFO clock until patterns written to ARDUCHIP_TEST1 at the
+ * register clock read back intact at the FIFO clock. Alternating the two
+ * configurations also makes the controller apply each new frequency.
+ */
+static void camera_probe_fifo_clock(const struct device *dev)
+{
+	const struct arducam_mega_config *cfg = dev->config;
+	struct arducam_mega_data *data = dev->data;
+	static const uint8_t patterns[] = {0x55, 0xaa, 0x00, 0xff, 0x5a, 0xa5, 0x0f, 0xf0};
+	struct spi_config *fifo_cfg = &data->fifo_spi.config;
+	uint8_t value;
+	size_t i;
+
+	while (fifo_cfg->frequency > cfg->spi_dt.config.frequency) {
+		for (i = 0; i < ARRAY_SIZE(patterns); i++) {
+			if (camera_write_reg(dev, ARDUCHIP_TEST1, patterns[i]) < 0 ||
+			    camera_bus_read(dev, &data->fifo_spi, ARDUCHIP_TEST1, &value) < 0 ||
+			    value != patterns[i]) {
+				break;
+			}
+		}
+		if (i == ARRAY_SIZE(patterns)) {
+			break;
+		}
+		LOG_DBG("%s: FIFO clock %u Hz unreliable", dev->name, fifo_cfg->frequency);
+		fifo_cfg->frequency =
+			MAX(fifo_cfg->frequency * 3 / 4, cfg->spi_dt.config.frequency);
+	}
+	LOG_INF("%s: FIFO clock %u Hz", dev->name, fifo_cfg->frequency);
+}
+#endif
+
+#if defined(CONFIG_PM_DEVICE)
+/*
+ * Standby only powers down the sensor's analog and clock domains, the sensor
+ * keeps its registers. Resuming therefore skips the reset and the shadowed
+ * configuration stays valid.
+ */
+static int arducam_mega_pm_action(const struct device *dev, enum pm_device_action action)
+{
+	struct arducam_mega_data *data = dev->data;
+	const struct arducam_mega_reg standby_regs[] = {
+		{CAM_REG_POWER_CONTROL, CAM_POWER_LOW_POWER_ON},
+	};
+	const struct arducam_mega_reg resume_regs[] = {
+		{CAM_REG_POWER_CONTROL, CAM_POWER_LOW_POWER_OFF},
+	};
+	uint32_t start;
+	int ret;
+
+	ret = camera_capture_lock(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	switch (action) {
+	case PM_DEVICE_ACTION_SUSPEND:
+		if (data->previewMode) {
+			ret = -EBUSY;
+			break;
+		}
+		ret = camera_write_regs(dev, standby_regs, ARRAY_SIZE(standby_regs));
+		break;
+	case PM_DEVICE_ACTION_RESUME:
+		start = k_cycle_get_32();
+		ret = camera_write_regs(dev, resume_regs, ARRAY_SIZE(resume_regs));
+		if (ret < 0) {
+			break;
+		}
+		data->resume_us = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+		LOG_DBG("%s: resumed in %u us", dev->name, data->resume_us);
+		break;
+	default:
+		ret = -ENOTSUP;
+		break;
+	}
+	camera_capture_unlock(dev);
+	return ret;
+}
+#endif
+
+static int arducam_mega_init(const struct device *dev)
+{
+	const struct arducam_mega_config *cfg = dev->config;
+	struct arducam_mega_data *data = dev->data;
+	struct video_format fmt = {
+		.pixelformat = VIDEO_PIX_FMT_JPEG,
+		.width = 320,
+		.height = 240,
+	};
+	int ret;
+
+	LOG_INF("Initializing the camera");
+	if (!spi_is_ready_dt(&cfg->spi_dt)) {
+		LOG_ERR("%s: SPI bus %s not ready", dev->name, cfg->spi_dt.bus->name);
+		return -ENODEV;
+	}
+
+	data->dev = dev;
+	/* The FIFO runs on the same device and chip select, only faster */
+	data->fifo_spi = cfg->spi_dt;
+	data->fifo_spi.config.frequency = MAX(cfg->fifo_frequency, cfg->spi_dt.config.frequency);
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+	stats_init(STATS_HDR(data->stats), STATS_SIZE_INIT_PARMS(data->stats, STATS_SIZE_32),
+		   STATS_NAME_INIT_PARMS(arducam_mega));
+	stats_register(dev->name, STATS_HDR(data->stats));
+#endif
+	k_mutex_init(&data->lock);
+	k_mutex_init(&data->capture_lock);
+	/* Restored after a failed capture resets the sensor */
+	arducam_mega_default_settings(&data->settings);
+	k_sem_init(&data->capture_sem, 0, 1);
+	if (cfg->int_gpio.port != NULL) {
+		if (!gpio_is_ready_dt(&cfg->int_gpio)) {
+			LOG_ERR("%s: interrupt GPIO not ready", dev->name);
+			return -ENODEV;
+		}
+		ret = gpio_pin_configure_dt(&cfg->int_gpio, GPIO_INPUT);
+		if (ret == 0) {
+			ret = gpio_pin_interrupt_configure_dt(&cfg->int_gpio,
+							      GPIO_INT_EDGE_TO_ACTIVE);
+		}
+		if (ret < 0) {
+			LOG_ERR("%s: couldn't configure interrupt GPIO %d", dev->name, ret);
+			return ret;
+		}
+		gpio_init_callback(&data->int_cb, camera_int_handler, BIT(cfg->int_gpio.pin));
+		gpio_add_callback(cfg->int_gpio.port, &data->int_cb);
+	}
+	k_fifo_init(&data->fifo_in);
+	k_fifo_init(&data->fifo_out);
+	k_work_init(&data->buf_work, arducam_mega_buffer_work);
+#if defined(CONFIG_ARDUCAM_MEGA_ASYNC)
+	k_work_init(&data->async_work, camera_async_work);
+	data->async_buffs[0] = data->fifo_buff;
+	data->async_buffs[1] = data->async_buff;
+	data->blockSize = sizeof(data->fifo_buff);
+#endif
+	k_work_queue_init(&data->workq);
+	k_work_queue_start(&data->workq, data->workq_stack,
+			   K_KERNEL_STACK_SIZEOF(data->workq_stack),
+			   CONFIG_ARDUCAM_MEGA_WORKQ_PRIORITY,
+			   &(struct k_work_queue_config){.name = dev->name});
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER)
+	k_msgq_init(&data->save_full, (char *)data->save_full_msgs,
+		    sizeof(struct arducam_mega_save_msg), ARRAY_SIZE(data->save_full_msgs));
+	k_msgq_init(&data->save_free, (char *)data->save_free_msgs, sizeof(uint8_t *),
+		    ARDUCAM_MEGA_SAVE_BUFFER_COUNT);
+	for (int i = 0; i < ARDUCAM_MEGA_SAVE_BUFFER_COUNT; i++) {
+		uint8_t *buff = data->save_buff[i];
+
+		k_msgq_put(&data->save_free, &buff, K_NO_WAIT);
+	}
+	k_sem_init(&data->save_done, 0, 1);
+	k_thread_create(&data->save_thread, data->save_stack,
+			K_KERNEL_STACK_SIZEOF(data->save_stack), camera_save_writer, data, NULL,
+			NULL, CONFIG_ARDUCAM_MEGA_SAVE_WRITER_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&data->save_thread, dev->name);
+#endif
+
+	ret = camera_sensor_reset(dev);
+	if (ret < 0) {
+		return ret;
+	}
+#if defined(CONFIG_ARDUCAM_MEGA_FIFO_PROBE)
+	camera_probe_fifo_clock(dev);
+#endif
+	ret = arducam_mega_get_id(dev);
+	if (ret < 0) {
+		return ret;
+	}
+	data->cameraId = ret;
+	return arducam_mega_set_fmt(dev, VIDEO_EP_OUT, &fmt);
+}
+
+#define ARDUCAM_MEGA_INIT(inst)                                                                    \
+	static const struct arducam_mega_config arducam_mega_config_##inst = {                     \
+		.spi_dt = SPI_DT_SPEC_INST_GET(inst, ARDUCAM_MEGA_SPI_OPERATION, 0),               \
+		.int_gpio = GPIO_DT_SPEC_INST_GET_OR(inst, int_gpios, {0}),                        \
+		.fifo_frequency = DT_INST_PROP_OR(inst, fifo_max_frequency,                        \
+						  DT_INST_PROP(inst, spi_max_frequency)),          \
+	};                                                                                         \
+                                                                                                   \
+	static struct arducam_mega_data arducam_mega_data_##inst;                                  \
+                                                                                                   \
+	PM_DEVICE_DT_INST_DEFINE(inst, arducam_mega_pm_action);                                    \
+                                                                                                   \
+	DEVICE_DT_INST_DEFINE(inst, arducam_mega_init, PM_DEVICE_DT_INST_GET(inst),                \
+			      &arducam_mega_data_##inst,                                           \
+			      &arducam_mega_config_##inst, POST_KERNEL,                            \
+			      CONFIG_ARDUCAM_MEGA_INIT_PRIORITY, &arducam_mega_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(ARDUCAM_MEGA_INIT)
@@ -26,6 +26,11 @@
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/video.h>
+#include <zephyr/kernel.h>
+#include <zephyr/stats/stats.h>
+
+#include "arducam_mega_jpeg.h"
 
 #define ARDUCHIP_FRAMES     0x01
 #define ARDUCHIP_TEST1      0x00 // TEST register
@@ -51,6 +56,22 @@
 
 #define BUF_MAX_LENGTH 255
 
+#if defined(CONFIG_ARDUCAM_MEGA_BURST_READ)
+#define ARDUCAM_MEGA_FIFO_CHUNK_SIZE CONFIG_ARDUCAM_MEGA_BURST_SIZE
+#else
+#define ARDUCAM_MEGA_FIFO_CHUNK_SIZE BUF_MAX_LENGTH
+#endif
+
+/* Filesystem writes are staged in whole blocks, aligned for DMA capable hosts */
+#define ARDUCAM_MEGA_SAVE_BUFFER_SIZE CONFIG_ARDUCAM_MEGA_SAVE_BUFFER_SIZE
+#define ARDUCAM_MEGA_SAVE_ALIGN       32
+
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER)
+#define ARDUCAM_MEGA_SAVE_BUFFER_COUNT CONFIG_ARDUCAM_MEGA_SAVE_BUFFER_COUNT
+#else
+#define ARDUCAM_MEGA_SAVE_BUFFER_COUNT 1
+#endif
+
 #define CAPRURE_MAX_NUM 0xff
 
 #define CAM_REG_POWER_CONTROL                      0X02
@@ -82,6 +103,8 @@
 #define CAM_REG_DEBUG_REGISTER_VALUE               0X0D
 
 #define CAM_REG_SENSOR_STATE_IDLE (1 << 1)
+#define CAM_POWER_LOW_POWER_ON    0X07
+#define CAM_POWER_LOW_POWER_OFF   0X05
 #define CAM_SENSOR_RESET_ENABLE   (1 << 6)
 #define CAM_FORMAT_BASICS         (0 << 0)
 #define CAM_SET_CAPTURE_MODE      (0 << 7)
@@ -246,7 +269,7 @@ typedef enum {
  * @brief Configure image pixel format
  */
 typedef enum {
-	CAM_IMAGE_PIX_FMT_RGB565 = 0x02, /**< RGB565 format */
+	CAM_IMAGE_PIX_FMT_RGB565 = 0x02, /**< RGB565 format, big-endian pixels */
 	CAM_IMAGE_PIX_FMT_JPG = 0x01,    /**< JPEG format */
 	CAM_IMAGE_PIX_FMT_YUV = 0x03,    /**< YUV format */
 	CAM_IMAGE_PIX_FMT_NONE,          /**< No defined format */
@@ -293,8 +316,14 @@ typedef enum {
 	CAM_AUTO_FOCUS_DISABLE,     /**< disable auto focus  */
 } CAM_AUTO_FOCUS;
 
-typedef uint8_t (*BUFFER_CALLBACK)(uint8_t *buffer,
-				   uint8_t lenght); /**<Callback function prototype  */
+/**
+ * @brief Callback function prototype
+ *
+ * Receives the image in chunks lent from the driver's readout buffer. The
+ * data is only valid until the callback returns. A non-zero return value
+ * aborts the readout and is passed back to the caller.
+ */
+typedef int (*BUFFER_CALLBACK)(uint8_t *buffer, uint32_t length, void *user_data);
 
 struct camera_info {
 	char *cameraId;                 /**<Model of camera module */
@@ -313,10 +342,153 @@ struct camera_info {
 	unsigned char deviceAddress;
 };
 
+/**
+ * @brief Complete set of image controls, applied to the camera as one batch
+ *
+ * A settings struct acts as a camera profile, e.g. one for daylight and one
+ * for night, switched with arducam_mega_apply_settings().
+ */
+struct arducam_mega_settings {
+	CAM_BRIGHTNESS_LEVEL brightness;
+	CAM_CONTRAST_LEVEL contrast;
+	CAM_SATURATION_LEVEL saturation;
+	CAM_EV_LEVEL ev;
+	CAM_SHARPNESS_LEVEL sharpness;
+	CAM_COLOR_FX color_fx;
+	CAM_AUTO_FOCUS autofocus;
+	CAM_WHITE_BALANCE white_balance; /**< White balance mode while auto_white_balance */
+	uint8_t auto_white_balance;      /**< Automatic white balance */
+	uint8_t auto_exposure;           /**< Automatic exposure, else exposure applies */
+	uint8_t auto_gain;               /**< Automatic gain, else gain applies */
+	uint32_t exposure;               /**< Manual exposure time, 20 bits */
+	uint16_t gain;                   /**< Manual gain, 10 bits */
+};
+
+#define ARDUCAM_MEGA_META_MAGIC   0x54454d41 /* "AMET" */
+#define ARDUCAM_MEGA_META_VERSION 1
+
+/**
+ * Metadata sidecar written with CONFIG_ARDUCAM_MEGA_SAVE_SIDECAR. Fields are
+ * little-endian.
+ */
+struct arducam_mega_save_meta {
+	uint32_t magic;             /**< ARDUCAM_MEGA_META_MAGIC */
+	uint8_t version;            /**< ARDUCAM_MEGA_META_VERSION */
+	uint8_t format;             /**< CAM_IMAGE_PIX_FMT of the frame */
+	uint16_t width;             /**< Frame width, 0 if unknown */
+	uint16_t height;            /**< Frame height, 0 if unknown */
+	uint16_t reserved;
+	int64_t timestamp;          /**< Uptime in ms when the capture completed */
+	uint32_t length;            /**< Image file length */
+	uint32_t crc32;             /**< CRC-32 of the file, 0 without CONFIG_ARDUCAM_MEGA_CRC */
+	uint8_t settings_valid;     /**< The controls below are known */
+	uint8_t brightness;
+	uint8_t contrast;
+	uint8_t saturation;
+	uint8_t ev;
+	uint8_t sharpness;
+	uint8_t color_fx;
+	uint8_t white_balance;
+	uint8_t auto_white_balance;
+	uint8_t auto_exposure;
+	uint8_t auto_gain;
+	uint8_t reserved2;
+	uint32_t exposure;
+	uint16_t gain;
+} __packed;
+
+/** Outcome of the last complete FIFO readout */
+struct arducam_mega_readout {
+	uint32_t length; /**< Bytes delivered, the JPEG trimmed to its markers */
+	uint32_t crc32;  /**< IEEE CRC-32 of those bytes, 0 without CONFIG_ARDUCAM_MEGA_CRC */
+};
+
+struct arducam_mega_stream_stats {
+	uint32_t frames;     /**< Frames delivered since the stream started */
+	uint32_t dropped;    /**< Frames larger than the buffer queued for them */
+	uint32_t elapsed_ms; /**< Time since the stream started */
+	uint32_t fps_x100;   /**< Achieved frame rate in hundredths of a frame per second */
+};
+
+/**
+ * @brief Phases of a capture accounted with CONFIG_ARDUCAM_MEGA_PROFILE
+ */
+enum arducam_mega_phase {
+	ARDUCAM_MEGA_PHASE_RESET,    /**< Sensor reset */
+	ARDUCAM_MEGA_PHASE_CONFIG,   /**< Format and resolution programming */
+	ARDUCAM_MEGA_PHASE_EXPOSURE, /**< Capture trigger until CAP_DONE */
+	ARDUCAM_MEGA_PHASE_LENGTH,   /**< FIFO length read */
+	ARDUCAM_MEGA_PHASE_READOUT,  /**< FIFO readout over SPI */
+	ARDUCAM_MEGA_PHASE_WRITE,    /**< Hand-off to the callback or filesystem */
+	ARDUCAM_MEGA_PHASE_COUNT,
+};
+
+struct arducam_mega_profile {
+	uint32_t captures;                               /**< Captures triggered */
+	uint64_t cycles[ARDUCAM_MEGA_PHASE_COUNT];       /**< Hardware cycles spent per phase */
+	uint32_t transactions[ARDUCAM_MEGA_PHASE_COUNT]; /**< SPI transactions issued per phase */
+};
+
+/**
+ * @brief Captured frame held in the driver's frame buffer pool
+ *
+ * Frames are reference counted: every consumer sharing a frame takes a
+ * reference with arducam_mega_frame_ref() and drops it with
+ * arducam_mega_frame_unref(). The buffer returns to the pool when the last
+ * reference is dropped.
+ */
+struct arducam_mega_frame {
+	uint8_t *data;             /**< Frame contents */
+	uint32_t size;             /**< Bytes available at data */
+	uint32_t length;           /**< Bytes of data in use */
+	CAM_IMAGE_PIX_FMT format;  /**< Pixel format of the frame */
+	CAM_IMAGE_MODE mode;       /**< Resolution the frame was captured at */
+	uint16_t width;            /**< Width in pixels */
+	uint16_t height;           /**< Height in pixels */
+	int64_t timestamp;         /**< Uptime in milliseconds when the capture completed */
+	uint32_t sequence;         /**< Per-camera capture sequence number */
+	atomic_t refcount;         /**< Number of holders of the frame */
+};
+
+/* Buffer handed from the FIFO reader to the filesystem writer thread */
+struct arducam_mega_save_msg {
+	void *sink;      /**< Save the buffer belongs to */
+	uint8_t *buff;   /**< Data to write, returned to the free queue once written */
+	uint32_t length; /**< Bytes of buff in use */
+	bool last;       /**< Last buffer of the save */
+};
+
+struct arducam_mega_stream {
+	BUFFER_CALLBACK function; /**< Consumer of the trimmed frame */
+	void *user_data;          /**< Argument for the consumer */
+	uint32_t total;           /**< Bytes read from the FIFO */
+	uint32_t delivered;       /**< Bytes handed to the consumer */
+	uint32_t crc;             /**< CRC-32 of the bytes handed to the consumer */
+	struct arducam_mega_jpeg_scanner scanner; /**< Locates the SOI/EOI markers */
+	uint8_t done;             /**< EOI marker delivered */
+	uint8_t raw;              /**< Raw pixels, delivered without a marker scan */
+};
+
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+STATS_SECT_START(arducam_mega)
+STATS_SECT_ENTRY32(spi_transactions) /* SPI transactions issued */
+STATS_SECT_ENTRY32(spi_bytes)        /* Bytes clocked over SPI */
+STATS_SECT_ENTRY32(spi_retries)      /* SPI transfers repeated after an error */
+STATS_SECT_ENTRY32(idle_waits)       /* Waits for the sensor to go idle */
+STATS_SECT_ENTRY32(idle_wait_us)     /* Time spent waiting for the sensor */
+STATS_SECT_ENTRY32(capture_polls)    /* CAP_DONE polls that found no frame */
+STATS_SECT_ENTRY32(fs_writes)        /* Filesystem writes */
+STATS_SECT_ENTRY32(fs_write_us)      /* Time spent in filesystem writes */
+STATS_SECT_ENTRY32(fs_write_max_us)  /* Slowest filesystem write */
+STATS_SECT_ENTRY32(frames)           /* Frames captured */
+STATS_SECT_ENTRY32(frame_errors)     /* Captures that failed */
+STATS_SECT_END;
+#endif
+
 struct arducam_mega_data {
 	uint32_t totalLength;            /**< The total length of the picture */
 	uint32_t receivedLength;         /**< The remaining length of the picture */
-	uint8_t blockSize;               /**< The length of the callback function transmission */
+	uint32_t blockSize;              /**< The length of the callback function transmission */
 	uint8_t cameraId;                /**< Model of camera module */
 	uint8_t cameraDataFormat;        /**< The currently set image pixel format */
 	uint8_t burstFirstFlag;          /**< Flag bit for reading data for the first time in
@@ -324,31 +496,340 @@ struct arducam_mega_data {
 	uint8_t previewMode;             /**< Stream mode flag */
 	uint8_t currentPixelFormat;      /**< The currently set image pixel format */
 	uint8_t currentPictureMode;      /**< Currently set resolution */
+	uint8_t settings_valid;          /**< settings matches the camera */
+	struct arducam_mega_settings settings; /**< Image controls last written */
 	struct camera_info myCameraInfo; /**< Basic information of the current camera */
 	const struct CameraOperations *arducamCameraOp; /**< Camera function interface */
 	BUFFER_CALLBACK callBackFunction;               /**< Camera callback function */
+	void *user_data;                                /**< Argument for the callback function */
+
+	const struct device *dev;        /**< Back-reference used by the work handlers */
+	struct spi_dt_spec fifo_spi;     /**< FIFO readout bus configuration */
+	struct video_format fmt;         /**< Format selected through the video API */
+	struct k_fifo fifo_in;           /**< Buffers queued by the application */
+	struct k_fifo fifo_out;          /**< Buffers holding captured frames */
+	struct k_work buf_work;          /**< Fills queued buffers while streaming */
+	struct k_work_q workq;           /**< Per-instance capture work queue */
+	struct k_mutex capture_lock;     /**< Serializes captures and their readout */
+	struct k_mutex lock;             /**< Held per register transaction and shadow update */
+	struct k_sem capture_sem;        /**< Given by the capture-done interrupt */
+	struct gpio_callback int_cb;     /**< Capture-done interrupt callback */
+	uint8_t video_mode;              /**< CAM_VIDEO_MODE while streaming, 0 for stills */
+	uint32_t stream_frames;          /**< Frames delivered since stream start */
+	uint32_t stream_dropped;         /**< Frames dropped since stream start */
+	int64_t stream_start;            /**< Uptime at stream start */
+	int64_t stream_stop;             /**< Uptime at stream stop */
+	uint32_t frame_sequence;         /**< Sequence number of the next pool frame */
+	uint32_t resume_us;              /**< Duration of the last resume from standby */
+	struct arducam_mega_readout readout; /**< Result of the last complete readout */
+	int64_t capture_time;            /**< Uptime when the last capture completed */
+	uint8_t readout_valid;           /**< readout matches the frame in the FIFO */
+#if defined(CONFIG_ARDUCAM_MEGA_STATS)
+	STATS_SECT_DECL(arducam_mega) stats; /**< Counters registered with the stats subsystem */
+#endif
+#if defined(CONFIG_ARDUCAM_MEGA_PROFILE)
+	struct arducam_mega_profile profile; /**< Per-phase accounting since the last reset */
+	uint32_t spi_transactions;           /**< SPI transactions issued since init */
+#endif
+	K_KERNEL_STACK_MEMBER(workq_stack, CONFIG_ARDUCAM_MEGA_WORKQ_STACK_SIZE);
+	uint8_t fifo_buff[ARDUCAM_MEGA_FIFO_CHUNK_SIZE] __aligned(4); /**< Readout buffer */
+	/** Filesystem write-back buffers */
+	uint8_t save_buff[ARDUCAM_MEGA_SAVE_BUFFER_COUNT][ARDUCAM_MEGA_SAVE_BUFFER_SIZE]
+		__aligned(ARDUCAM_MEGA_SAVE_ALIGN);
+#if defined(CONFIG_ARDUCAM_MEGA_SAVE_WRITER)
+	struct k_msgq save_free;         /**< Save buffers ready to be filled */
+	struct k_msgq save_full;         /**< Save buffers waiting for the writer */
+	struct k_sem save_done;          /**< Given once the writer took the last buffer */
+	struct k_thread save_thread;     /**< Filesystem writer */
+	uint8_t *save_free_msgs[ARDUCAM_MEGA_SAVE_BUFFER_COUNT];
+	/** Every buffer plus the last message of a save, which may carry none */
+	struct arducam_mega_save_msg save_full_msgs[ARDUCAM_MEGA_SAVE_BUFFER_COUNT + 1];
+	K_KERNEL_STACK_MEMBER(save_stack, CONFIG_ARDUCAM_MEGA_SAVE_WRITER_STACK_SIZE);
+#endif
+#if defined(CONFIG_ARDUCAM_MEGA_ASYNC)
+	struct arducam_mega_stream async_stream; /**< State of the asynchronous readout */
+	struct k_work async_work;                /**< Runs after each chunk transfer */
+	struct k_poll_signal *async_signal;      /**< Raised once the frame is drained */
+	struct spi_buf async_tx_buf;
+	struct spi_buf async_rx_buf[3];
+	struct spi_buf_set async_tx_bufs;
+	struct spi_buf_set async_rx_bufs;
+	uint8_t async_cmd;
+	uint8_t async_index;                     /**< Buffer of the transfer in flight */
+	uint8_t *async_buffs[2];                 /**< fifo_buff and async_buff */
+	uint32_t async_count[2];                 /**< Length of the transfer per buffer */
+	int async_result;
+	int64_t async_start;
+	atomic_t async_busy;
+	uint8_t async_buff[ARDUCAM_MEGA_FIFO_CHUNK_SIZE] __aligned(4); /**< Second readout buffer */
+#endif
 };
 
 struct arducam_mega_config {
-	struct gpio_dt_spec gpio_dt;
-	struct spi_dt_spec spi_dt;
-	struct spi_config spi_cfg;
-	CAM_IMAGE_MODE resolution;
+	struct spi_dt_spec spi_dt;      /**< Register access, at spi-max-frequency */
+	uint32_t fifo_frequency;        /**< FIFO readout clock, fifo-max-frequency */
+	struct gpio_dt_spec int_gpio; /**< Optional capture-done interrupt line */
 };
 
-int arducam_mega_init();
-int arducam_mega_capture_image(CAM_IMAGE_MODE mode, CAM_IMAGE_PIX_FMT pixel_format);
-int arducam_mega_save_image(char *filename, const char *mount_point, int image_length);
-int arducam_mega_get_id();
+/**
+ * @brief Capture a frame into the camera FIFO
+ *
+ * JPEG frames are located by their markers when read out. RGB565 and YUV
+ * frames are read out at exactly two bytes per pixel. A failed capture is
+ * retried up to CONFIG_ARDUCAM_MEGA_CAPTURE_RETRIES times, each time after a
+ * sensor reset that writes the image controls last set back to the sensor.
+ *
+ * @return Length of the frame in the FIFO, -EINVAL for an unsupported
+ *         format, -ETIMEDOUT if the camera did not report completion
+ *         within CONFIG_ARDUCAM_MEGA_CAPTURE_TIMEOUT_MS, -EIO if the FIFO
+ *         length does not fit the frame or a negative errno from the bus.
+ */
+int arducam_mega_capture_image(const struct device *dev, CAM_IMAGE_MODE mode,
+			       CAM_IMAGE_PIX_FMT pixel_format);
+
+/**
+ * @brief Save the frame in the camera FIFO to a file
+ *
+ * The file is rewritten from the start through a block-aligned buffer of
+ * CONFIG_ARDUCAM_MEGA_SAVE_BUFFER_SIZE bytes. With
+ * CONFIG_ARDUCAM_MEGA_SAVE_ATOMIC the frame only appears under @p filename
+ * once it is complete.
+ *
+ * @return 0, -ENAMETOOLONG if the path is longer than 255 bytes or a negative
+ *         errno from the readout or the filesystem.
+ */
+int arducam_mega_save_image(const struct device *dev, char *filename, const char *mount_point,
+			    int image_length);
+
+/**
+ * @brief Save the frame like arducam_mega_save_image() and return its digest
+ *
+ * @param readout If not NULL, receives the length and CRC-32 of the bytes
+ *        written on success.
+ */
+int arducam_mega_save_image_readout(const struct device *dev, char *filename,
+				    const char *mount_point, int image_length,
+				    struct arducam_mega_readout *readout);
+
+/**
+ * @brief Read a raw RGB565 or YUV frame into a caller buffer
+ *
+ * Lines are written @p pitch bytes apart, so the frame can land directly in
+ * a larger image or a padded tensor. A @p pitch of 0 packs the lines.
+ *
+ * @return 0, -ENOTSUP if the last capture was JPEG, -EINVAL if @p pitch is
+ *         shorter than a line or -EIO if the FIFO ran dry.
+ */
+int arducam_mega_read_frame(const struct device *dev, uint8_t *buffer, uint32_t pitch);
+
+/**
+ * @brief Deliver a raw RGB565 or YUV frame to @p function one line at a time
+ *
+ * @return 0, -ENOTSUP if the last capture was JPEG, -ENOSPC if a line does not
+ *         fit the readout buffer, -EIO or the callback's non-zero return.
+ */
+int arducam_mega_stream_lines(const struct device *dev, BUFFER_CALLBACK function,
+			      void *user_data);
+int arducam_mega_get_id(const struct device *dev);
+
+/**
+ * @brief Register the consumer used by arducam_mega_stream_image()
+ *
+ * @param block_size Maximum chunk length handed to @p function, capped to
+ *        the driver's readout buffer size. 0 selects the maximum.
+ */
+int arducam_mega_register_callback(const struct device *dev, BUFFER_CALLBACK function,
+				   uint32_t block_size, void *user_data);
+
+/**
+ * @brief Stream the captured JPEG frame to the registered callback
+ *
+ * The frame is trimmed to its SOI/EOI markers and delivered in place from
+ * the driver's readout buffer, without an intermediate copy.
+ *
+ * @return Number of bytes delivered, -EINVAL if no callback is registered,
+ *         -EBADMSG if the FIFO ran dry before the JPEG end marker or a
+ *         negative errno.
+ */
+int arducam_mega_stream_image(const struct device *dev, int image_length);
+
+/**
+ * @brief Stream the frame like arducam_mega_stream_image() and return its digest
+ *
+ * @param readout If not NULL, receives the length and CRC-32 of the bytes
+ *        delivered on success.
+ */
+int arducam_mega_stream_image_readout(const struct device *dev, int image_length,
+				      struct arducam_mega_readout *readout);
+
+/**
+ * @brief Stream the captured JPEG frame to the registered callback asynchronously
+ *
+ * The FIFO is drained with double-buffered asynchronous SPI transfers. The
+ * callback runs on the camera's work queue for each chunk while the next one
+ * is being transferred. @p signal, if not NULL, is raised with the number of
+ * bytes delivered or a negative errno once the frame is done.
+ *
+ * @return 0 if the readout was started, -EBUSY if one is already running,
+ *         -EINVAL if no callback is registered or a negative errno.
+ */
+int arducam_mega_stream_image_async(const struct device *dev, int image_length,
+				    struct k_poll_signal *signal);
+
+/**
+ * @brief Get the length and checksum of the last frame read out
+ *
+ * Covers arducam_mega_save_image(), arducam_mega_stream_image(),
+ * arducam_mega_stream_image_async(), arducam_mega_read_frame(),
+ * arducam_mega_stream_lines() and arducam_mega_capture_frame(). The CRC-32
+ * is computed on the fly as each chunk leaves the FIFO, over exactly the
+ * bytes written to the file, handed to the callback or left in the buffer,
+ * so it can be checked against the stored frame without reading it back.
+ * Burst captures, video API frames and arducam_mega_read_buffer() record no
+ * readout.
+ *
+ * @return 0, -ENODATA if no readout completed since the last capture or
+ *         partial read, or -EBUSY while an asynchronous readout is running.
+ */
+int arducam_mega_get_readout(const struct device *dev, struct arducam_mega_readout *readout);
+
+/**
+ * @brief Get frame rate and drop statistics of the current or last video stream
+ */
+int arducam_mega_get_stream_stats(const struct device *dev,
+				  struct arducam_mega_stream_stats *stats);
+
+/**
+ * @brief Get the per-phase capture accounting
+ *
+ * @return 0 or -ENOTSUP without CONFIG_ARDUCAM_MEGA_PROFILE.
+ */
+int arducam_mega_get_profile(const struct device *dev, struct arducam_mega_profile *profile);
+void arducam_mega_reset_profile(const struct device *dev);
+
+/**
+ * @brief Print the per-phase accounting as CSV lines
+ *
+ * Each phase is printed as
+ * "arducam_mega_profile,<device>,<tag>,<phase>,<captures>,<cycles>,<us>,<spi transactions>"
+ * so runs can be collected from the console and compared across builds.
+ * @p tag labels the run, e.g. with the resolution under test.
+ */
+void arducam_mega_print_profile(const struct device *dev, const char *tag);
+
+/**
+ * @brief Time the last resume from standby took until the sensor was ready
+ *
+ * Standby is entered and left through device power management, e.g.
+ * pm_device_action_run(dev, PM_DEVICE_ACTION_SUSPEND).
+ *
+ * @return Latency in microseconds, 0 if the camera was never resumed.
+ */
+uint32_t arducam_mega_get_resume_latency(const struct device *dev);
+
+/**
+ * @brief Read raw FIFO data of the last capture into a caller buffer
+ *
+ * @return Number of bytes read, 0 once the FIFO has been drained or a
+ *         negative errno from the bus.
+ */
+int arducam_mega_read_buffer(const struct device *dev, uint8_t *buffer, uint32_t length);
+
+/**
+ * @brief Allocate a frame from the pool with a single reference
+ *
+ * @return The frame or NULL if none became free within @p timeout.
+ */
+struct arducam_mega_frame *arducam_mega_frame_alloc(k_timeout_t timeout);
+void arducam_mega_frame_ref(struct arducam_mega_frame *frame);
+void arducam_mega_frame_unref(struct arducam_mega_frame *frame);
+
+/**
+ * @brief Capture a frame straight into a pool buffer
+ *
+ * On success @p frame holds one reference owned by the caller.
+ *
+ * @return 0, -ENOMEM if no pool buffer became free within @p timeout,
+ *         -ENOSPC if the frame is larger than a pool buffer, -EBADMSG if
+ *         the FIFO holds no complete JPEG frame or a negative errno from
+ *         the capture.
+ */
+int arducam_mega_capture_frame(const struct device *dev, CAM_IMAGE_MODE mode,
+			       CAM_IMAGE_PIX_FMT pixel_format, struct arducam_mega_frame **frame,
+			       k_timeout_t timeout);
+
+/**
+ * @brief Capture a burst of JPEG frames back to back
+ *
+ * The camera is programmed with ARDUCHIP_FRAMES to capture @p count frames
+ * into its FIFO in one go, which are then split into pool buffers. As the
+ * camera only signals the end of the burst, frame timestamps are spread
+ * evenly between the trigger and completion.
+ *
+ * @param frames Receives one referenced frame per captured frame, NULL for
+ *        frames that were not found in the FIFO.
+ * @param count Number of frames, 1 to CAPRURE_MAX_NUM.
+ *
+ * @return Number of frames captured, -EINVAL, -ENOMEM if the pool could not
+ *         supply @p count buffers within @p timeout, -ENOSPC if a frame is
+ *         larger than a pool buffer or a negative errno from the capture.
+ */
+int arducam_mega_capture_burst(const struct device *dev, CAM_IMAGE_MODE mode,
+			       struct arducam_mega_frame **frames, uint8_t count,
+			       k_timeout_t timeout);
+
 CAM_IMAGE_MODE arducam_mega_get_resolution(char *resolution);
 
 CAM_SATURATION_LEVEL arducam_mega_get_saturation(char *saturation);
 CAM_CONTRAST_LEVEL arducam_mega_get_contrast(char *contrast);
 CAM_BRIGHTNESS_LEVEL arducam_mega_get_brightness(char *brightness);
 
-int arducam_mega_set_saturation(CAM_SATURATION_LEVEL saturation);
-int arducam_mega_set_contrast(CAM_CONTRAST_LEVEL contrast);
-int arducam_mega_set_brightness(CAM_BRIGHTNESS_LEVEL brightness);
-int arducam_mega_set_autofocus(CAM_AUTO_FOCUS autofocus);
+int arducam_mega_set_saturation(const struct device *dev, CAM_SATURATION_LEVEL saturation);
+int arducam_mega_set_contrast(const struct device *dev, CAM_CONTRAST_LEVEL contrast);
+int arducam_mega_set_brightness(const struct device *dev, CAM_BRIGHTNESS_LEVEL brightness);
+int arducam_mega_set_autofocus(const struct device *dev, CAM_AUTO_FOCUS autofocus);
+int arducam_mega_set_ev(const struct device *dev, CAM_EV_LEVEL ev);
+int arducam_mega_set_sharpness(const struct device *dev, CAM_SHARPNESS_LEVEL sharpness);
+int arducam_mega_set_color_fx(const struct device *dev, CAM_COLOR_FX color_fx);
+int arducam_mega_set_white_balance(const struct device *dev, CAM_WHITE_BALANCE white_balance);
+/**
+ * @brief Switch between automatic (@p enable) and fixed white balance
+ */
+int arducam_mega_set_auto_white_balance(const struct device *dev, bool enable);
+/**
+ * @brief Set a manual exposure time, disabling automatic exposure
+ */
+int arducam_mega_set_exposure(const struct device *dev, uint32_t exposure);
+int arducam_mega_set_auto_exposure(const struct device *dev, bool enable);
+/**
+ * @brief Set a manual gain, disabling automatic gain
+ */
+int arducam_mega_set_gain(const struct device *dev, uint16_t gain);
+int arducam_mega_set_auto_gain(const struct device *dev, bool enable);
+
+/**
+ * @brief Settings the sensor comes out of reset with
+ */
+void arducam_mega_default_settings(struct arducam_mega_settings *settings);
+
+/**
+ * @brief Apply a complete set of image controls
+ *
+ * Only the controls that differ from what was last applied are written, all
+ * in one register batch followed by a single wait for the sensor.
+ *
+ * @return 0, -ETIMEDOUT if the sensor did not take the batch within
+ *         CONFIG_ARDUCAM_MEGA_IDLE_TIMEOUT_MS or a negative errno from the
+ *         bus. After an error all controls are written again next time.
+ */
+int arducam_mega_apply_settings(const struct device *dev,
+				const struct arducam_mega_settings *settings);
+
+/**
+ * @brief Get the controls last applied
+ *
+ * @return 0 or -ENODATA if the controls are unknown since the last reset.
+ */
+int arducam_mega_get_settings(const struct device *dev, struct arducam_mega_settings *settings);
 
 #endif /* __ARDUCAM_MEGA_H__ */
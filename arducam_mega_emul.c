@@ -0,0 +1,256 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#define DT_DRV_COMPAT arducam_mega
+
+#include "arducam_mega.h"
+#include "arducam_mega_emul.h"
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/spi_emul.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(arducam_mega_emul);
+
+#define EMUL_REG_COUNT   0x80
+#define EMUL_DUMMY_BYTE  0x00
+#define EMUL_SENSOR_ID   0x81
+
+/* Smallest well-formed JPEG the driver has to cope with, plus FIFO padding */
+static const uint8_t emul_jpeg_fixture[] = {
+	0xff, 0xd8,                                                 /* SOI */
+	0xff, 0xe0, 0x00, 0x10, 'J',  'F',  'I',  'F',  0x00, 0x01, /* APP0 */
+	0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+	0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00, /* SOS */
+	0x12, 0x34, 0xff, 0x00, 0x56, 0xff, 0xd0, 0x78,             /* Entropy data */
+	0xff, 0xd9,                                                 /* EOI */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,             /* Padding */
+};
+
+struct arducam_mega_emul_data {
+	uint8_t regs[EMUL_REG_COUNT];
+	const uint8_t *fifo;
+	uint32_t fifo_length;
+	uint32_t fifo_pos;
+	uint32_t exposure_ms;
+	int64_t capture_done;
+	bool capturing;
+	bool burst_first;
+	uint32_t transactions;
+	uint32_t bytes;
+};
+
+static uint8_t emul_buf_get(const struct spi_buf_set *bufs, size_t pos)
+{
+	for (size_t i = 0; bufs != NULL && i < bufs->count; i++) {
+		if (pos < bufs->buffers[i].len) {
+			const uint8_t *buf = bufs->buffers[i].buf;
+
+			return buf != NULL ? buf[pos] : EMUL_DUMMY_BYTE;
+		}
+		pos -= bufs->buffers[i].len;
+	}
+	return EMUL_DUMMY_BYTE;
+}
+
+static void emul_buf_put(const struct spi_buf_set *bufs, size_t pos, uint8_t value)
+{
+	for (size_t i = 0; bufs != NULL && i < bufs->count; i++) {
+		if (pos < bufs->buffers[i].len) {
+			uint8_t *buf = bufs->buffers[i].buf;
+
+			if (buf != NULL) {
+				buf[pos] = value;
+			}
+			return;
+		}
+		pos -= bufs->buffers[i].len;
+	}
+}
+
+static size_t emul_buf_len(const struct spi_buf_set *bufs)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; bufs != NULL && i < bufs->count; i++) {
+		len += bufs->buffers[i].len;
+	}
+	return len;
+}
+
+static uint8_t emul_fifo_byte(struct arducam_mega_emul_data *data)
+{
+	if (data->fifo_pos >= data->fifo_length) {
+		return EMUL_DUMMY_BYTE;
+	}
+	return data->fifo[data->fifo_pos++];
+}
+
+static uint8_t emul_read_reg(struct arducam_mega_emul_data *data, uint8_t reg)
+{
+	switch (reg) {
+	case ARDUCHIP_TRIG:
+		/* Shares its address with CAM_REG_SENSOR_STATE, the sensor is always idle */
+		if (data->capturing && k_uptime_get() >= data->capture_done) {
+			return CAM_REG_SENSOR_STATE_IDLE | CAP_DONE_MASK;
+		}
+		return CAM_REG_SENSOR_STATE_IDLE;
+	case FIFO_SIZE1:
+		return data->fifo_length & 0xff;
+	case FIFO_SIZE2:
+		return (data->fifo_length >> 8) & 0xff;
+	case FIFO_SIZE3:
+		return (data->fifo_length >> 16) & 0xff;
+	default:
+		return data->regs[reg];
+	}
+}
+
+static void emul_write_reg(struct arducam_mega_emul_data *data, uint8_t reg, uint8_t value)
+{
+	data->regs[reg] = value;
+
+	if (reg == CAM_REG_SENSOR_RESET && (value & CAM_SENSOR_RESET_ENABLE)) {
+		/* The sensor controls return to their power-on values */
+		memset(&data->regs[CAM_REG_FORMAT], 0,
+		       CAM_REG_MANUAL_EXPOSURE_BIT_7_0 - CAM_REG_FORMAT + 1);
+		return;
+	}
+	if (reg != ARDUCHIP_FIFO) {
+		return;
+	}
+	if (value & FIFO_CLEAR_ID_MASK) {
+		data->capturing = false;
+	}
+	if (value & FIFO_START_MASK) {
+		data->capturing = true;
+		data->capture_done = k_uptime_get() + data->exposure_ms;
+		data->fifo_pos = 0;
+		data->burst_first = true;
+	}
+}
+
+static int arducam_mega_emul_io(const struct emul *target, const struct spi_config *config,
+				const struct spi_buf_set *tx_bufs,
+				const struct spi_buf_set *rx_bufs)
+{
+	struct arducam_mega_emul_data *data = target->data;
+	size_t len = MAX(emul_buf_len(tx_bufs), emul_buf_len(rx_bufs));
+	uint8_t cmd = emul_buf_get(tx_bufs, 0);
+	uint8_t value;
+
+	data->transactions++;
+	data->bytes += len;
+
+	/* The command byte itself clocks in a dummy */
+	emul_buf_put(rx_bufs, 0, EMUL_DUMMY_BYTE);
+	for (size_t pos = 1; pos < len; pos++) {
+		value = EMUL_DUMMY_BYTE;
+		if (cmd & 0x80) {
+			if (pos == 1) {
+				emul_write_reg(data, cmd & 0x7f, emul_buf_get(tx_bufs, pos));
+			}
+		} else if (cmd == BURST_FIFO_READ) {
+			/* Only the first burst after a capture starts with a dummy byte */
+			if (pos > 1 || !data->burst_first) {
+				value = emul_fifo_byte(data);
+			}
+		} else if (cmd == SINGLE_FIFO_READ) {
+			if (pos == 2) {
+				value = emul_fifo_byte(data);
+			}
+		} else if (pos == 2) {
+			value = emul_read_reg(data, cmd);
+		}
+		emul_buf_put(rx_bufs, pos, value);
+	}
+	if (cmd == BURST_FIFO_READ) {
+		data->burst_first = false;
+	}
+	return 0;
+}
+
+static const struct spi_emul_api arducam_mega_emul_api = {
+	.io = arducam_mega_emul_io,
+};
+
+void arducam_mega_emul_set_fifo(const struct emul *target, const uint8_t *fifo, size_t length)
+{
+	struct arducam_mega_emul_data *data = target->data;
+
+	if (fifo == NULL) {
+		fifo = emul_jpeg_fixture;
+		length = sizeof(emul_jpeg_fixture);
+	}
+	data->fifo = fifo;
+	data->fifo_length = length;
+	data->fifo_pos = 0;
+}
+
+void arducam_mega_emul_set_exposure(const struct emul *target, uint32_t exposure_ms)
+{
+	struct arducam_mega_emul_data *data = target->data;
+
+	data->exposure_ms = exposure_ms;
+}
+
+uint8_t arducam_mega_emul_get_reg(const struct emul *target, uint8_t reg)
+{
+	struct arducam_mega_emul_data *data = target->data;
+
+	return data->regs[reg & 0x7f];
+}
+
+void arducam_mega_emul_get_counters(const struct emul *target, uint32_t *transactions,
+				    uint32_t *bytes)
+{
+	struct arducam_mega_emul_data *data = target->data;
+
+	*transactions = data->transactions;
+	*bytes = data->bytes;
+}
+
+void arducam_mega_emul_reset_counters(const struct emul *target)
+{
+	struct arducam_mega_emul_data *data = target->data;
+
+	data->transactions = 0;
+	data->bytes = 0;
+}
+
+static int arducam_mega_emul_init(const struct emul *target, const struct device *parent)
+{
+	struct arducam_mega_emul_data *data = target->data;
+
+	memset(data->regs, 0, sizeof(data->regs));
+	data->regs[CAM_REG_SENSOR_ID] = EMUL_SENSOR_ID;
+	arducam_mega_emul_set_fifo(target, NULL, 0);
+	return 0;
+}
+
+#define ARDUCAM_MEGA_EMUL(inst)                                                                    \
+	static struct arducam_mega_emul_data arducam_mega_emul_data_##inst;                        \
+	EMUL_DT_INST_DEFINE(inst, arducam_mega_emul_init, &arducam_mega_emul_data_##inst, NULL,   \
+			    &arducam_mega_emul_api, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(ARDUCAM_MEGA_EMUL)
@@ -0,0 +1,54 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#ifndef __ARDUCAM_MEGA_EMUL_H__
+#define __ARDUCAM_MEGA_EMUL_H__
+
+#include <zephyr/drivers/emul.h>
+
+/**
+ * @brief Load the FIFO contents returned by the next captures
+ *
+ * @p data is referenced, not copied, and must stay valid while in use. A
+ * NULL @p data restores the built-in JPEG fixture.
+ */
+void arducam_mega_emul_set_fifo(const struct emul *target, const uint8_t *data, size_t length);
+
+/**
+ * @brief Set the time between a capture trigger and CAP_DONE
+ */
+void arducam_mega_emul_set_exposure(const struct emul *target, uint32_t exposure_ms);
+
+/**
+ * @brief Read back a register as last written by the driver
+ */
+uint8_t arducam_mega_emul_get_reg(const struct emul *target, uint8_t reg);
+
+/**
+ * @brief Get the number of SPI transactions and bytes seen since the last reset
+ */
+void arducam_mega_emul_get_counters(const struct emul *target, uint32_t *transactions,
+				    uint32_t *bytes);
+
+void arducam_mega_emul_reset_counters(const struct emul *target);
+
+#endif /* __ARDUCAM_MEGA_EMUL_H__ */
@@ -0,0 +1,192 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#include "arducam_mega_jpeg.h"
+#include <errno.h>
+#include <string.h>
+
+#define JPEG_SOI  0xD8
+#define JPEG_EOI  0xD9
+#define JPEG_SOS  0xDA
+#define JPEG_RST0 0xD0
+#define JPEG_RST7 0xD7
+#define JPEG_TEM  0x01
+
+enum {
+	SCAN_SEEK_SOI,    /* Looking for the 0xFF of SOI */
+	SCAN_SEEK_SOI_FF, /* 0xFF seen, expecting SOI */
+	SCAN_HEADER,      /* Expecting the 0xFF of the next marker */
+	SCAN_MARKER,      /* 0xFF seen, expecting a marker code */
+	SCAN_LENGTH_HI,   /* Expecting the high byte of a segment length */
+	SCAN_LENGTH_LO,   /* Expecting the low byte of a segment length */
+	SCAN_SKIP,        /* Skipping a segment payload */
+	SCAN_ENTROPY,     /* Looking for the next 0xFF in entropy-coded data */
+	SCAN_DONE,        /* EOI reached */
+};
+
+/* Returns the first 0xFF in [p, end), testing a word at a time */
+static const uint8_t *jpeg_find_ff(const uint8_t *p, const uint8_t *end)
+{
+	uint32_t word;
+
+	while (p < end && ((uintptr_t)p & (sizeof(word) - 1)) != 0) {
+		if (*p == 0xff) {
+			return p;
+		}
+		p++;
+	}
+	/* A word holds an 0xFF byte iff its complement holds a zero byte */
+	while ((size_t)(end - p) >= sizeof(word)) {
+		memcpy(&word, p, sizeof(word));
+		word = ~word;
+		if (((word - 0x01010101u) & ~word & 0x80808080u) != 0) {
+			break;
+		}
+		p += sizeof(word);
+	}
+	while (p < end) {
+		if (*p == 0xff) {
+			return p;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+void arducam_mega_jpeg_scan_init(struct arducam_mega_jpeg_scanner *scanner)
+{
+	*scanner = (struct arducam_mega_jpeg_scanner){
+		.soi = ARDUCAM_MEGA_JPEG_NONE,
+		.end = ARDUCAM_MEGA_JPEG_NONE,
+		.state = SCAN_SEEK_SOI,
+	};
+}
+
+int arducam_mega_jpeg_scan(struct arducam_mega_jpeg_scanner *scanner, const uint8_t *buffer,
+			   size_t length, size_t *used)
+{
+	const uint8_t *p = buffer;
+	const uint8_t *end = buffer + length;
+	size_t skip;
+	uint8_t code;
+
+	while (p < end && scanner->state != SCAN_DONE) {
+		switch (scanner->state) {
+		case SCAN_SEEK_SOI:
+		case SCAN_ENTROPY:
+			p = jpeg_find_ff(p, end);
+			if (p == NULL) {
+				p = end;
+				break;
+			}
+			p++;
+			scanner->state =
+				scanner->state == SCAN_SEEK_SOI ? SCAN_SEEK_SOI_FF : SCAN_MARKER;
+			break;
+		case SCAN_SEEK_SOI_FF:
+			code = *p++;
+			if (code == JPEG_SOI) {
+				scanner->soi = scanner->offset + (p - buffer) - 2;
+				scanner->state = SCAN_HEADER;
+			} else if (code != 0xff) {
+				scanner->state = SCAN_SEEK_SOI;
+			}
+			break;
+		case SCAN_HEADER:
+			if (*p++ != 0xff) {
+				return -EBADMSG;
+			}
+			scanner->state = SCAN_MARKER;
+			break;
+		case SCAN_MARKER:
+			code = *p++;
+			if (code == 0xff) {
+				/* Fill byte, the marker code follows */
+			} else if (code == JPEG_EOI) {
+				scanner->end = scanner->offset + (p - buffer);
+				scanner->state = SCAN_DONE;
+			} else if (code == 0x00 || (code >= JPEG_RST0 && code <= JPEG_RST7)) {
+				/* Stuffed 0xFF or restart marker, only valid in a scan */
+				if (!scanner->in_scan) {
+					return -EBADMSG;
+				}
+				scanner->state = SCAN_ENTROPY;
+			} else if (code == JPEG_TEM) {
+				scanner->state = scanner->in_scan ? SCAN_ENTROPY : SCAN_HEADER;
+			} else {
+				scanner->marker = code;
+				scanner->in_scan = 0;
+				scanner->state = SCAN_LENGTH_HI;
+			}
+			break;
+		case SCAN_LENGTH_HI:
+			scanner->segment = *p++ << 8;
+			scanner->state = SCAN_LENGTH_LO;
+			break;
+		case SCAN_LENGTH_LO:
+			scanner->segment |= *p++;
+			if (scanner->segment < 2) {
+				return -EBADMSG;
+			}
+			/* The length field counts itself */
+			scanner->segment -= 2;
+			scanner->state = SCAN_SKIP;
+			/* fall through */
+		case SCAN_SKIP:
+			skip = end - p;
+			if (skip > scanner->segment) {
+				skip = scanner->segment;
+			}
+			p += skip;
+			scanner->segment -= skip;
+			if (scanner->segment == 0) {
+				scanner->in_scan = scanner->marker == JPEG_SOS;
+				scanner->state = scanner->in_scan ? SCAN_ENTROPY : SCAN_HEADER;
+			}
+			break;
+		}
+	}
+
+	*used = p - buffer;
+	scanner->offset += *used;
+	return scanner->state == SCAN_DONE ? ARDUCAM_MEGA_JPEG_COMPLETE : ARDUCAM_MEGA_JPEG_MORE;
+}
+
+int arducam_mega_jpeg_find_frame(const uint8_t *buffer, size_t length, size_t *start,
+				 size_t *end)
+{
+	struct arducam_mega_jpeg_scanner scanner;
+	size_t used;
+	int ret;
+
+	arducam_mega_jpeg_scan_init(&scanner);
+	ret = arducam_mega_jpeg_scan(&scanner, buffer, length, &used);
+	if (ret < 0) {
+		return ret;
+	}
+	if (ret != ARDUCAM_MEGA_JPEG_COMPLETE) {
+		return -ENODATA;
+	}
+	*start = scanner.soi;
+	*end = scanner.end;
+	return 0;
+}
@@ -0,0 +1,85 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#ifndef __ARDUCAM_MEGA_JPEG_H__
+#define __ARDUCAM_MEGA_JPEG_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Offset value of a marker that has not been found yet */
+#define ARDUCAM_MEGA_JPEG_NONE UINT32_MAX
+
+/**
+ * @enum ARDUCAM_MEGA_JPEG_STATUS
+ * @brief Result of feeding a chunk to the marker scanner
+ */
+typedef enum {
+	ARDUCAM_MEGA_JPEG_MORE = 0,     /**< EOI not reached, feed the next chunk */
+	ARDUCAM_MEGA_JPEG_COMPLETE = 1, /**< EOI reached, frame boundaries are known */
+} ARDUCAM_MEGA_JPEG_STATUS;
+
+/**
+ * @brief Incremental JPEG SOI/EOI marker scanner
+ *
+ * The scanner walks the marker segments of a JPEG stream fed in arbitrary
+ * chunks. Segment payloads are skipped by length, so markers inside EXIF
+ * thumbnails are not mistaken for frame boundaries. Entropy-coded data is
+ * searched for 0xFF a word at a time, honouring 0xFF00 byte stuffing and
+ * restart markers. Markers split across chunks are handled.
+ */
+struct arducam_mega_jpeg_scanner {
+	uint32_t offset;  /**< Stream offset of the next byte to be fed */
+	uint32_t soi;     /**< Stream offset of the SOI marker */
+	uint32_t end;     /**< Stream offset one past the EOI marker */
+	uint16_t segment; /**< Bytes left in the marker segment being skipped */
+	uint8_t marker;   /**< Marker whose segment is being parsed */
+	uint8_t state;    /**< Parser state */
+	uint8_t in_scan;  /**< Inside entropy-coded data */
+};
+
+void arducam_mega_jpeg_scan_init(struct arducam_mega_jpeg_scanner *scanner);
+
+/**
+ * @brief Feed the next chunk of the stream to the scanner
+ *
+ * @param used Number of bytes of @p buffer belonging to the stream up to and
+ *        including EOI; @p length unless the frame completed in this chunk.
+ *
+ * @return ARDUCAM_MEGA_JPEG_MORE, ARDUCAM_MEGA_JPEG_COMPLETE or -EBADMSG if
+ *         the stream is not a well-formed JPEG.
+ */
+int arducam_mega_jpeg_scan(struct arducam_mega_jpeg_scanner *scanner, const uint8_t *buffer,
+			   size_t length, size_t *used);
+
+/**
+ * @brief Locate a complete JPEG frame in a buffer
+ *
+ * @param start Offset of the SOI marker.
+ * @param end Offset one past the EOI marker.
+ *
+ * @return 0, -ENODATA if the buffer holds no complete frame or -EBADMSG.
+ */
+int arducam_mega_jpeg_find_frame(const uint8_t *buffer, size_t length, size_t *start,
+				 size_t *end);
+
+#endif /* __ARDUCAM_MEGA_JPEG_H__ */
@@ -0,0 +1,183 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#include "arducam_mega_proc.h"
+#include <errno.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#endif
+
+/* BT.601 luma weights in 1/256 */
+#define GRAY_R 77
+#define GRAY_G 150
+#define GRAY_B 29
+
+/* Two pixels at a time; lines come from the FIFO buffer in host byte order */
+static inline uint32_t proc_load32(const uint8_t *src)
+{
+	uint32_t word;
+
+	memcpy(&word, src, sizeof(word));
+	return word;
+}
+
+static inline uint32_t proc_rgb565_gray(uint32_t pixel)
+{
+	uint32_t r = (pixel >> 11) & 0x1f;
+	uint32_t g = (pixel >> 5) & 0x3f;
+	uint32_t b = pixel & 0x1f;
+
+	/* Expand to 8 bits per channel before weighting */
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+	return (GRAY_R * r + GRAY_G * g + GRAY_B * b) >> 8;
+}
+
+static void proc_sum_rgb565(const uint8_t *src, uint16_t *acc, uint16_t pixels, uint8_t shift,
+			    bool swap)
+{
+	uint32_t word;
+
+	for (uint16_t x = 0; x < pixels; x += 2, src += 4) {
+		word = proc_load32(src);
+		if (swap) {
+			/* Big-endian pixels: put each back in its own half, in order */
+			word = __builtin_bswap32(word);
+			word = (word >> 16) | (word << 16);
+		}
+		acc[x >> shift] += proc_rgb565_gray(word & 0xffff);
+		acc[(x + 1) >> shift] += proc_rgb565_gray(word >> 16);
+	}
+}
+
+static void proc_sum_yuyv(const uint8_t *src, uint16_t *acc, uint16_t pixels, uint8_t shift)
+{
+	uint32_t word;
+
+	if (shift == 0) {
+		for (uint16_t x = 0; x < pixels; x += 2, src += 4) {
+			word = proc_load32(src);
+			acc[x] += word & 0xff;
+			acc[x + 1] += (word >> 16) & 0xff;
+		}
+		return;
+	}
+	/* Both lumas of a pair fall into the same output pixel */
+	for (uint16_t x = 0; x < pixels; x += 2, src += 4) {
+		word = proc_load32(src);
+#if defined(__ARM_FEATURE_SIMD32)
+		acc[x >> shift] += __usad8(word & 0x00ff00ff, 0);
+#else
+		acc[x >> shift] += (word & 0xff) + ((word >> 16) & 0xff);
+#endif
+	}
+}
+
+int arducam_mega_proc_init(struct arducam_mega_proc *proc,
+			   const struct arducam_mega_proc_config *cfg, uint16_t *acc, uint8_t *out)
+{
+	uint8_t shift;
+
+	switch (cfg->scale) {
+	case 1:
+		shift = 0;
+		break;
+	case 2:
+		shift = 1;
+		break;
+	case 4:
+		shift = 2;
+		break;
+	case 8:
+		shift = 3;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	memset(proc, 0, sizeof(*proc));
+	proc->cfg = *cfg;
+	if (proc->cfg.crop_width == 0) {
+		proc->cfg.crop_width = cfg->width - cfg->crop_x;
+	}
+	if (proc->cfg.crop_height == 0) {
+		proc->cfg.crop_height = cfg->height - cfg->crop_y;
+	}
+	cfg = &proc->cfg;
+	if (cfg->crop_x + cfg->crop_width > cfg->width ||
+	    cfg->crop_y + cfg->crop_height > cfg->height) {
+		return -EINVAL;
+	}
+	/* Pixels are consumed in pairs */
+	if ((cfg->crop_x | cfg->crop_width) & 1) {
+		return -EINVAL;
+	}
+	if ((cfg->crop_width | cfg->crop_height) & (cfg->scale - 1)) {
+		return -EINVAL;
+	}
+
+	proc->acc = acc;
+	proc->out = out;
+	proc->width = ARDUCAM_MEGA_PROC_WIDTH(cfg->crop_width, cfg->scale);
+	proc->shift = shift;
+	memset(acc, 0, proc->width * sizeof(*acc));
+	return 0;
+}
+
+int arducam_mega_proc_feed(uint8_t *line, uint32_t length, void *user_data)
+{
+	struct arducam_mega_proc *proc = user_data;
+	const struct arducam_mega_proc_config *cfg = &proc->cfg;
+	uint16_t y = proc->y++;
+	const uint8_t *src;
+	uint8_t area_shift;
+
+	if (y < cfg->crop_y || y >= cfg->crop_y + cfg->crop_height) {
+		return 0;
+	}
+	if (length < cfg->width * 2) {
+		return -EINVAL;
+	}
+
+	src = &line[cfg->crop_x * 2];
+	if (cfg->format == ARDUCAM_MEGA_PROC_YUYV) {
+		proc_sum_yuyv(src, proc->acc, cfg->crop_width, proc->shift);
+	} else {
+		proc_sum_rgb565(src, proc->acc, cfg->crop_width, proc->shift,
+				cfg->format == ARDUCAM_MEGA_PROC_RGB565X);
+	}
+	if (++proc->rows < cfg->scale) {
+		return 0;
+	}
+
+	/* A box of scale x scale inputs is complete, average it */
+	area_shift = proc->shift * 2;
+	for (uint16_t x = 0; x < proc->width; x++) {
+		proc->out[x] = proc->acc[x] >> area_shift;
+	}
+	memset(proc->acc, 0, proc->width * sizeof(*proc->acc));
+	proc->rows = 0;
+	return cfg->output(proc->out, proc->width, cfg->user_data);
+}
@@ -0,0 +1,99 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#ifndef __ARDUCAM_MEGA_PROC_H__
+#define __ARDUCAM_MEGA_PROC_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @enum ARDUCAM_MEGA_PROC_FORMAT
+ * @brief Layout of the raw lines fed to the processing stage
+ */
+typedef enum {
+	ARDUCAM_MEGA_PROC_RGB565 = 0,  /**< RGB565, little-endian pixels */
+	ARDUCAM_MEGA_PROC_RGB565X = 1, /**< RGB565, big-endian pixels */
+	ARDUCAM_MEGA_PROC_YUYV = 2,    /**< YUV422, Y0 U Y1 V */
+} ARDUCAM_MEGA_PROC_FORMAT;
+
+/* Output line consumer, return non-zero to stop the readout */
+typedef int (*arducam_mega_proc_output_t)(uint8_t *line, uint32_t length, void *user_data);
+
+struct arducam_mega_proc_config {
+	ARDUCAM_MEGA_PROC_FORMAT format; /**< Layout of the input lines */
+	uint16_t width;                  /**< Input frame width in pixels */
+	uint16_t height;                 /**< Input frame height in pixels */
+	uint16_t crop_x;                 /**< Left edge of the region, even */
+	uint16_t crop_y;                 /**< Top edge of the region */
+	uint16_t crop_width;             /**< Region width, 0 for the full width */
+	uint16_t crop_height;            /**< Region height, 0 for the full height */
+	uint8_t scale;                   /**< Box downscale factor: 1, 2, 4 or 8 */
+	arducam_mega_proc_output_t output; /**< Receives each 8-bit grayscale output line */
+	void *user_data;                 /**< Argument for the output */
+};
+
+/**
+ * @brief Streaming grayscale, crop and box-downscale stage
+ *
+ * Raw lines are consumed as they are read out of the FIFO. Only one
+ * accumulator line and one output line are kept, so the memory needed does
+ * not depend on the frame height.
+ */
+struct arducam_mega_proc {
+	struct arducam_mega_proc_config cfg;
+	uint16_t *acc;   /**< Sums of the output line being built */
+	uint8_t *out;    /**< Output line */
+	uint16_t width;  /**< Output width in pixels */
+	uint16_t y;      /**< Index of the next input line */
+	uint8_t rows;    /**< Input lines summed into acc */
+	uint8_t shift;   /**< log2 of scale */
+};
+
+/* Output width for a region of @p crop_width pixels */
+#define ARDUCAM_MEGA_PROC_WIDTH(crop_width, scale) ((crop_width) / (scale))
+
+/**
+ * @brief Set up a processing stage
+ *
+ * @param acc Accumulator of ARDUCAM_MEGA_PROC_WIDTH() entries.
+ * @param out Output line of ARDUCAM_MEGA_PROC_WIDTH() bytes.
+ *
+ * @return 0 or -EINVAL if the region does not fit the frame, is not a
+ *         multiple of the scale or the scale is not supported.
+ */
+int arducam_mega_proc_init(struct arducam_mega_proc *proc,
+			   const struct arducam_mega_proc_config *cfg, uint16_t *acc, uint8_t *out);
+
+/**
+ * @brief Consume one raw input line
+ *
+ * Matches BUFFER_CALLBACK so that it can be handed to
+ * arducam_mega_stream_lines() directly with the stage as user data.
+ *
+ * @return 0, -EINVAL if the line is shorter than the frame width or the
+ *         output's non-zero return.
+ */
+int arducam_mega_proc_feed(uint8_t *line, uint32_t length, void *user_data);
+
+#endif /* __ARDUCAM_MEGA_PROC_H__ */
@@ -0,0 +1,170 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+/*
+ * Captures and saves a synthetic JPEG at every resolution in CAM_IMAGE_MODE
+ * against the SPI emulator and prints the per-phase profile of each as CSV:
+ *
+ * arducam_mega_profile,<device>,<resolution>,<phase>,<captures>,<cycles>,<us>,<spi transactions>
+ *
+ * The emulated FIFO holds roughly a tenth of a byte per pixel, in line with
+ * what the sensor produces at its default JPEG quality.
+ */
+
+#include <ff.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+#include "arducam_mega.h"
+#include "arducam_mega_emul.h"
+
+#define CAMERA_NODE DT_NODELABEL(camera0)
+
+#define MOUNT_POINT "/RAM:"
+/* Captures accounted per resolution */
+#define PROFILE_ROUNDS 3
+/* Time the emulated sensor takes to expose a frame */
+#define EXPOSURE_MS 30
+
+static const struct {
+	CAM_IMAGE_MODE mode;
+	const char *name;
+	uint32_t pixels;
+} modes[] = {
+	{CAM_IMAGE_MODE_QQVGA, "160x120", 160 * 120},
+	{CAM_IMAGE_MODE_QVGA, "320x240", 320 * 240},
+	{CAM_IMAGE_MODE_VGA, "640x480", 640 * 480},
+	{CAM_IMAGE_MODE_SVGA, "800x600", 800 * 600},
+	{CAM_IMAGE_MODE_HD, "1280x720", 1280 * 720},
+	{CAM_IMAGE_MODE_SXGAM, "1280x960", 1280 * 960},
+	{CAM_IMAGE_MODE_UXGA, "1600x1200", 1600 * 1200},
+	{CAM_IMAGE_MODE_FHD, "1920x1080", 1920 * 1080},
+	{CAM_IMAGE_MODE_QXGA, "2048x1536", 2048 * 1536},
+	{CAM_IMAGE_MODE_WQXGA2, "2592x1944", 2592 * 1944},
+	{CAM_IMAGE_MODE_96X96, "96x96", 96 * 96},
+	{CAM_IMAGE_MODE_128X128, "128x128", 128 * 128},
+	{CAM_IMAGE_MODE_320X320, "320x320", 320 * 320},
+};
+
+static const uint8_t jpeg_header[] = {
+	0xff, 0xd8,                                                 /* SOI */
+	0xff, 0xe0, 0x00, 0x10, 'J',  'F',  'I',  'F',  0x00, 0x01, /* APP0 */
+	0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+	0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00, /* SOS */
+};
+
+/* Bytes of FIFO padding after EOI */
+#define JPEG_PADDING 8
+
+static uint8_t fifo[512 * 1024];
+static FATFS fat_fs;
+static struct fs_mount_t mount = {
+	.type = FS_FATFS,
+	.mnt_point = MOUNT_POINT,
+	.fs_data = &fat_fs,
+};
+
+/* Fills the FIFO with a JPEG of @p length bytes including padding */
+static size_t fill_jpeg(size_t length)
+{
+	size_t end = length - JPEG_PADDING - 2;
+	uint32_t seed = 0x2545f491u;
+	size_t pos;
+
+	memcpy(fifo, jpeg_header, sizeof(jpeg_header));
+	pos = sizeof(jpeg_header);
+	while (pos < end) {
+		seed = seed * 1664525u + 1013904223u;
+		fifo[pos++] = seed >> 24;
+		/* Keep 0xFF stuffed, as the encoder does */
+		if (fifo[pos - 1] == 0xff) {
+			if (pos == end) {
+				fifo[pos - 1] = 0x00;
+				break;
+			}
+			fifo[pos++] = 0x00;
+		}
+	}
+	fifo[pos++] = 0xff;
+	fifo[pos++] = 0xd9;
+	memset(&fifo[pos], 0, JPEG_PADDING);
+	return pos + JPEG_PADDING;
+}
+
+static int profile_mode(const struct device *camera, const struct emul *emul, int index)
+{
+	char filename[] = "frame.jpg";
+	size_t length;
+	int ret;
+
+	length = CLAMP(modes[index].pixels / 10, 64, sizeof(fifo));
+	arducam_mega_emul_set_fifo(emul, fifo, fill_jpeg(length));
+	arducam_mega_reset_profile(camera);
+
+	for (int round = 0; round < PROFILE_ROUNDS; round++) {
+		ret = arducam_mega_capture_image(camera, modes[index].mode,
+						 CAM_IMAGE_PIX_FMT_JPG);
+		if (ret < 0) {
+			printk("%s: capture failed %d\n", modes[index].name, ret);
+			return ret;
+		}
+		ret = arducam_mega_save_image(camera, filename, MOUNT_POINT, ret);
+		if (ret < 0) {
+			printk("%s: save failed %d\n", modes[index].name, ret);
+			return ret;
+		}
+	}
+	arducam_mega_print_profile(camera, modes[index].name);
+	return 0;
+}
+
+int main(void)
+{
+	const struct device *const camera = DEVICE_DT_GET(CAMERA_NODE);
+	const struct emul *const emul = EMUL_DT_GET(CAMERA_NODE);
+	int ret;
+
+	if (!device_is_ready(camera)) {
+		printk("%s not ready\n", camera->name);
+		return 0;
+	}
+	ret = fs_mount(&mount);
+	if (ret < 0) {
+		printk("Couldn't mount %s %d\n", MOUNT_POINT, ret);
+		return 0;
+	}
+
+	/* The sensor reset done at init */
+	arducam_mega_print_profile(camera, "init");
+
+	arducam_mega_emul_set_exposure(emul, EXPOSURE_MS);
+	for (int i = 0; i < ARRAY_SIZE(modes); i++) {
+		if (profile_mode(camera, emul, i) < 0) {
+			return 0;
+		}
+	}
+	printk("arducam_mega_profile done\n");
+	return 0;
+}
@@ -0,0 +1,267 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/ztest.h>
+
+#include "arducam_mega.h"
+#include "arducam_mega_emul.h"
+
+#define CAMERA_NODE DT_NODELABEL(camera0)
+
+/* Chunk length handed to the stream callback */
+#define STREAM_BLOCK_SIZE 16
+
+#define RAW_WIDTH  96
+#define RAW_HEIGHT 96
+#define RAW_LINE   (RAW_WIDTH * 2)
+#define RAW_SIZE   (RAW_LINE * RAW_HEIGHT)
+
+static const struct device *const camera = DEVICE_DT_GET(CAMERA_NODE);
+static const struct emul *const emul = EMUL_DT_GET(CAMERA_NODE);
+
+/* FIFO padding, a JPEG frame with stuffing and a restart marker, padding */
+static const uint8_t jpeg_fifo[] = {
+	0x00, 0x00, 0x00,                                           /* Padding */
+	0xff, 0xd8,                                                 /* SOI */
+	0xff, 0xe1, 0x00, 0x0a, 'E',  'x',  0xff, 0xd8, 0xff, 0xd9, /* APP1 */
+	0xff, 0xd9,
+	0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00, /* SOS */
+	0x12, 0x34, 0xff, 0x00, 0xd9, 0x56, 0xff, 0xd0, 0x78, 0x9a, /* Entropy data */
+	0xbc, 0xde, 0xf0, 0x11, 0x22, 0x33,
+	0xff, 0xd9,                                                 /* EOI */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,             /* Padding */
+};
+
+#define JPEG_SOI 3
+#define JPEG_END (sizeof(jpeg_fifo) - 8)
+
+static uint8_t raw_fifo[RAW_SIZE];
+static uint8_t raw_frame[RAW_SIZE];
+
+static uint8_t received[sizeof(jpeg_fifo)];
+static uint32_t received_length;
+static uint32_t received_chunks;
+
+static int stream_callback(uint8_t *buffer, uint32_t length, void *user_data)
+{
+	if (received_length + length > sizeof(received)) {
+		return -ENOSPC;
+	}
+	memcpy(&received[received_length], buffer, length);
+	received_length += length;
+	received_chunks++;
+	return 0;
+}
+
+static uint32_t emul_transactions(uint32_t *bytes)
+{
+	uint32_t transactions, count;
+
+	arducam_mega_emul_get_counters(emul, &transactions, &count);
+	if (bytes != NULL) {
+		*bytes = count;
+	}
+	return transactions;
+}
+
+static void *arducam_mega_setup(void)
+{
+	zassert_true(device_is_ready(camera), "camera not ready");
+	for (size_t i = 0; i < sizeof(raw_fifo); i++) {
+		raw_fifo[i] = i * 7 + (i >> 8);
+	}
+	return NULL;
+}
+
+static void arducam_mega_before(void *fixture)
+{
+	arducam_mega_emul_set_fifo(emul, jpeg_fifo, sizeof(jpeg_fifo));
+	arducam_mega_emul_set_exposure(emul, 0);
+	arducam_mega_emul_reset_counters(emul);
+	received_length = 0;
+	received_chunks = 0;
+}
+
+ZTEST(arducam_mega, test_capture)
+{
+	zassert_equal(arducam_mega_capture_image(camera, CAM_IMAGE_MODE_QVGA,
+						 CAM_IMAGE_PIX_FMT_JPG),
+		      sizeof(jpeg_fifo));
+	/* The capture started and cleared the FIFO and went over the bus */
+	zassert_true(emul_transactions(NULL) > 0);
+	zassert_equal(arducam_mega_emul_get_reg(emul, CAM_REG_FORMAT), CAM_IMAGE_PIX_FMT_JPG);
+	zassert_equal(arducam_mega_emul_get_reg(emul, CAM_REG_CAPTURE_RESOLUTION),
+		      CAM_SET_CAPTURE_MODE | CAM_IMAGE_MODE_QVGA);
+}
+
+ZTEST(arducam_mega, test_stream_jpeg)
+{
+	struct arducam_mega_readout readout, last;
+	uint32_t transactions, bytes, read;
+	int length;
+
+	length = arducam_mega_capture_image(camera, CAM_IMAGE_MODE_QVGA, CAM_IMAGE_PIX_FMT_JPG);
+	zassert_equal(length, sizeof(jpeg_fifo));
+	zassert_ok(arducam_mega_register_callback(camera, stream_callback, STREAM_BLOCK_SIZE,
+						  NULL));
+
+	arducam_mega_emul_reset_counters(emul);
+	zassert_equal(arducam_mega_stream_image_readout(camera, length, &readout),
+		      JPEG_END - JPEG_SOI);
+	transactions = emul_transactions(&bytes);
+
+	/* Trimmed to SOI/EOI, the thumbnail markers did not end the frame */
+	zassert_equal(received_length, JPEG_END - JPEG_SOI);
+	zassert_mem_equal(received, &jpeg_fifo[JPEG_SOI], received_length);
+	zassert_equal(readout.length, received_length);
+	zassert_equal(readout.crc32, crc32_ieee(received, received_length));
+	zassert_ok(arducam_mega_get_readout(camera, &last));
+	zassert_mem_equal(&last, &readout, sizeof(readout));
+
+	/* The readout stops with the chunk holding EOI */
+	read = MIN(ROUND_UP(JPEG_END, STREAM_BLOCK_SIZE), sizeof(jpeg_fifo));
+	if (IS_ENABLED(CONFIG_ARDUCAM_MEGA_BURST_READ)) {
+		/* One transfer per chunk: command, the dummy byte of the first burst, data */
+		zassert_equal(transactions, DIV_ROUND_UP(JPEG_END, STREAM_BLOCK_SIZE));
+		zassert_equal(bytes, read + transactions + 1);
+	} else {
+		/* One SINGLE_FIFO_READ of command, dummy and data byte per byte */
+		zassert_equal(transactions, read);
+		zassert_equal(bytes, 3 * read);
+	}
+}
+
+ZTEST(arducam_mega, test_read_raw_frame)
+{
+	struct arducam_mega_readout readout;
+	uint32_t transactions;
+
+	arducam_mega_emul_set_fifo(emul, raw_fifo, sizeof(raw_fifo));
+	zassert_equal(arducam_mega_capture_image(camera, CAM_IMAGE_MODE_96X96,
+						 CAM_IMAGE_PIX_FMT_RGB565),
+		      RAW_SIZE);
+
+	arducam_mega_emul_reset_counters(emul);
+	memset(raw_frame, 0, sizeof(raw_frame));
+	zassert_ok(arducam_mega_read_frame(camera, raw_frame, 0));
+	transactions = emul_transactions(NULL);
+
+	zassert_mem_equal(raw_frame, raw_fifo, sizeof(raw_frame));
+	zassert_ok(arducam_mega_get_readout(camera, &readout));
+	zassert_equal(readout.length, RAW_SIZE);
+	zassert_equal(readout.crc32, crc32_ieee(raw_frame, RAW_SIZE));
+	if (IS_ENABLED(CONFIG_ARDUCAM_MEGA_BURST_READ)) {
+		/* Every line is read in whole chunks, straight into the frame */
+		zassert_equal(transactions,
+			      RAW_HEIGHT * DIV_ROUND_UP(RAW_LINE, ARDUCAM_MEGA_FIFO_CHUNK_SIZE));
+	} else {
+		zassert_equal(transactions, RAW_SIZE);
+	}
+}
+
+ZTEST(arducam_mega, test_read_raw_short_fifo)
+{
+	/* A FIFO shorter than the frame fails the length check on every attempt */
+	arducam_mega_emul_set_fifo(emul, raw_fifo, sizeof(raw_fifo) - 1);
+	zassert_equal(arducam_mega_capture_image(camera, CAM_IMAGE_MODE_96X96,
+						 CAM_IMAGE_PIX_FMT_RGB565),
+		      -EIO);
+}
+
+ZTEST(arducam_mega, test_capture_timeout)
+{
+	int64_t start;
+
+	zassert_ok(arducam_mega_set_brightness(camera, CAM_BRIGHTNESS_LEVEL_2));
+	zassert_ok(arducam_mega_set_color_fx(camera, CAM_COLOR_FX_BW));
+	zassert_ok(arducam_mega_set_autofocus(camera, CAM_AUTO_FOCUS_DISABLE));
+
+	/* CAP_DONE never comes */
+	arducam_mega_emul_set_exposure(emul, UINT32_MAX);
+	start = k_uptime_get();
+	zassert_equal(arducam_mega_capture_image(camera, CAM_IMAGE_MODE_QVGA,
+						 CAM_IMAGE_PIX_FMT_JPG),
+		      -ETIMEDOUT);
+	/* Every attempt waited for the whole timeout */
+	zassert_true(k_uptime_get() - start >= (CONFIG_ARDUCAM_MEGA_CAPTURE_RETRIES + 1) *
+						       CONFIG_ARDUCAM_MEGA_CAPTURE_TIMEOUT_MS);
+
+	/* The sensor resets left the image controls as they were set */
+	zassert_equal(arducam_mega_emul_get_reg(emul, CAM_REG_BRIGHTNESS_CONTROL),
+		      CAM_BRIGHTNESS_LEVEL_2);
+	zassert_equal(arducam_mega_emul_get_reg(emul, CAM_REG_COLOR_EFFECT_CONTROL),
+		      CAM_COLOR_FX_BW);
+	zassert_equal(arducam_mega_emul_get_reg(emul, CAM_REG_AUTO_FOCUS_CONTROL),
+		      CAM_AUTO_FOCUS_DISABLE);
+
+	/* The camera recovers once the sensor behaves again */
+	arducam_mega_emul_set_exposure(emul, 0);
+	zassert_equal(arducam_mega_capture_image(camera, CAM_IMAGE_MODE_QVGA,
+						 CAM_IMAGE_PIX_FMT_JPG),
+		      sizeof(jpeg_fifo));
+}
+
+ZTEST(arducam_mega, test_truncated_jpeg)
+{
+	int length;
+
+	/* The FIFO ends before EOI */
+	arducam_mega_emul_set_fifo(emul, jpeg_fifo, JPEG_END - 1);
+	length = arducam_mega_capture_image(camera, CAM_IMAGE_MODE_QVGA, CAM_IMAGE_PIX_FMT_JPG);
+	zassert_equal(length, JPEG_END - 1);
+	zassert_ok(arducam_mega_register_callback(camera, stream_callback, 0, NULL));
+	zassert_equal(arducam_mega_stream_image(camera, length), -EBADMSG);
+}
+
+ZTEST(arducam_mega, test_burst_split)
+{
+	/* Two frames back to back, the second after the padding of both */
+	static uint8_t burst_fifo[2 * sizeof(jpeg_fifo)];
+	const size_t second_soi = sizeof(jpeg_fifo) - JPEG_END + JPEG_SOI;
+	struct arducam_mega_frame *frames[2];
+
+	memcpy(burst_fifo, jpeg_fifo, sizeof(jpeg_fifo));
+	memcpy(&burst_fifo[sizeof(jpeg_fifo)], jpeg_fifo, sizeof(jpeg_fifo));
+	arducam_mega_emul_set_fifo(emul, burst_fifo, sizeof(burst_fifo));
+
+	zassert_equal(arducam_mega_capture_burst(camera, CAM_IMAGE_MODE_QVGA, frames,
+						 ARRAY_SIZE(frames), K_NO_WAIT),
+		      ARRAY_SIZE(frames));
+	for (size_t i = 0; i < ARRAY_SIZE(frames); i++) {
+		const uint8_t *block = (const uint8_t *)(frames[i] + 1);
+
+		zassert_equal(frames[i]->length, JPEG_END - JPEG_SOI, "frame %zu", i);
+		zassert_mem_equal(frames[i]->data, &jpeg_fifo[JPEG_SOI], frames[i]->length);
+		/* Trimming to the SOI takes the skipped bytes off the capacity too */
+		zassert_equal(frames[i]->data + frames[i]->size,
+			      block + CONFIG_ARDUCAM_MEGA_FRAME_SIZE, "frame %zu", i);
+	}
+	zassert_equal(frames[0]->size, CONFIG_ARDUCAM_MEGA_FRAME_SIZE - JPEG_SOI);
+	zassert_equal(frames[1]->size, CONFIG_ARDUCAM_MEGA_FRAME_SIZE - second_soi);
+	arducam_mega_frame_unref(frames[0]);
+	arducam_mega_frame_unref(frames[1]);
+}
+
+ZTEST_SUITE(arducam_mega, NULL, arducam_mega_setup, arducam_mega_before, NULL, NULL);
@@ -0,0 +1,86 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#include <time.h>
+#include <zephyr/ztest.h>
+
+#include "arducam_mega_jpeg.h"
+#include "jpeg_fixture.h"
+
+/* A 5MP JPEG is typically a few hundred KiB */
+#define BENCH_FRAME_SIZE (256 * 1024)
+#define BENCH_ROUNDS     20
+
+static uint8_t frame[BENCH_FRAME_SIZE];
+static struct jpeg_fixture fx;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Scans the frame BENCH_ROUNDS times in @p chunk byte pieces, prints MB/s */
+static void bench_scan(size_t chunk)
+{
+	struct arducam_mega_jpeg_scanner scanner;
+	uint64_t start = now_ns();
+	uint64_t elapsed;
+	size_t used;
+	int ret = ARDUCAM_MEGA_JPEG_MORE;
+
+	for (int round = 0; round < BENCH_ROUNDS; round++) {
+		arducam_mega_jpeg_scan_init(&scanner);
+		for (size_t pos = 0; pos < fx.length; pos += used) {
+			ret = arducam_mega_jpeg_scan(&scanner, &frame[pos],
+						     MIN(chunk, fx.length - pos), &used);
+			if (ret != ARDUCAM_MEGA_JPEG_MORE) {
+				break;
+			}
+		}
+		zassert_equal(ret, ARDUCAM_MEGA_JPEG_COMPLETE);
+		zassert_equal(scanner.end, fx.eoi_end);
+	}
+	elapsed = MAX(now_ns() - start, 1);
+
+	TC_PRINT("chunk %6zu: %llu MB/s\n", chunk,
+		 (unsigned long long)((uint64_t)fx.eoi_end * BENCH_ROUNDS * 1000 / elapsed));
+}
+
+static void *bench_setup(void)
+{
+	jpeg_fixture_build(&fx, frame, sizeof(frame));
+	return NULL;
+}
+
+ZTEST(jpeg_bench, test_throughput)
+{
+	/* Single-byte reads, the default burst size and a whole frame */
+	bench_scan(1);
+	bench_scan(1024);
+	bench_scan(4096);
+	bench_scan(BENCH_FRAME_SIZE);
+}
+
+ZTEST_SUITE(jpeg_bench, NULL, bench_setup, NULL, NULL, NULL);
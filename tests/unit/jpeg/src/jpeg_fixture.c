@@ -0,0 +1,95 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#include <string.h>
+
+#include "jpeg_fixture.h"
+
+/* Bytes of FIFO contents after EOI */
+#define FIXTURE_TRAILER 5
+
+static const uint8_t padding[] = {0x00, 0xff, 0x00, 0xff, 0xff, 0x55};
+
+static const uint8_t header[] = {
+	/* SOI */
+	0xff, 0xd8,
+	/* APP1 EXIF with a thumbnail that has its own SOI/EOI */
+	0xff, 0xe1, 0x00, 0x12, 'E', 'x', 'i', 'f', 0x00, 0x00,
+	0xff, 0xd8, 0xff, 0xdb, 0x00, 0x02, 0xff, 0xd9, 0xff, 0xd9,
+	/* DQT */
+	0xff, 0xdb, 0x00, 0x05, 0x00, 0x10, 0x0b,
+	/* SOF0 behind fill bytes */
+	0xff, 0xff, 0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x10, 0x00, 0x10, 0x01,
+	0x01, 0x11, 0x00,
+	/* DRI */
+	0xff, 0xdd, 0x00, 0x04, 0x00, 0x01,
+	/* SOS */
+	0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00,
+};
+
+void jpeg_fixture_build(struct jpeg_fixture *fx, uint8_t *buffer, size_t size)
+{
+	/* Entropy data ends two bytes before EOI to fit a final stuffed pair */
+	size_t last = size - FIXTURE_TRAILER - 2;
+	uint32_t seed = 0x2545f491u;
+	uint8_t rst = 0;
+	size_t pos;
+
+	memcpy(buffer, padding, sizeof(padding));
+	memcpy(&buffer[sizeof(padding)], header, sizeof(header));
+	pos = sizeof(padding) + sizeof(header);
+
+	while (pos < last) {
+		uint8_t byte;
+
+		seed = seed * 1664525u + 1013904223u;
+		byte = seed >> 24;
+		if (pos + 2 <= last && (seed & 0x3f00) == 0) {
+			/* Restart marker, with a fill byte now and then */
+			buffer[pos++] = 0xff;
+			if ((seed & 0x10000) != 0 && pos + 2 <= last) {
+				buffer[pos++] = 0xff;
+			}
+			buffer[pos++] = 0xd0 + (rst++ & 7);
+		} else if (byte == 0xff || (seed & 0x1f0000) == 0) {
+			if (pos + 2 > last) {
+				buffer[pos++] = 0x00;
+				continue;
+			}
+			/* Stuffed 0xFF, often followed by a byte that looks like EOI */
+			buffer[pos++] = 0xff;
+			buffer[pos++] = 0x00;
+		} else {
+			buffer[pos++] = (seed & 0x300000) == 0 ? 0xd9 : byte;
+		}
+	}
+
+	buffer[pos++] = 0xff;
+	buffer[pos++] = 0xd9;
+	memset(&buffer[pos], 0xff, FIXTURE_TRAILER);
+	buffer[pos + 1] = 0xd8;
+
+	fx->data = buffer;
+	fx->length = size;
+	fx->soi = sizeof(padding);
+	fx->eoi_end = pos;
+}
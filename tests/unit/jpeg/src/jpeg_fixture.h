@@ -0,0 +1,51 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#ifndef __JPEG_FIXTURE_H__
+#define __JPEG_FIXTURE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Synthetic FIFO contents holding one JPEG frame
+ *
+ * The frame is preceded by FIFO padding and followed by junk. Its header
+ * carries an EXIF thumbnail with its own SOI/EOI, a DQT and fill bytes
+ * before SOF; the entropy-coded data contains 0xFF00 stuffing and restart
+ * markers.
+ */
+struct jpeg_fixture {
+	uint8_t *data;  /**< Start of the FIFO contents */
+	size_t length;  /**< Bytes of FIFO contents */
+	size_t soi;     /**< Offset of the SOI marker */
+	size_t eoi_end; /**< Offset one past the EOI marker */
+};
+
+/**
+ * @brief Fill @p buffer with a fixture of exactly @p size bytes
+ *
+ * @p size must leave room for the headers, at least 256 bytes.
+ */
+void jpeg_fixture_build(struct jpeg_fixture *fx, uint8_t *buffer, size_t size);
+
+#endif /* __JPEG_FIXTURE_H__ */
@@ -0,0 +1,213 @@
+/* MIT License */
+
+/* Copyright (c) [year] [fullname] */
+
+/* Permission is hereby granted, free of charge, to any person obtaining a copy */
+/* of this software and associated documentation files (the "Software"), to deal */
+/* in the Software without restriction, including without limitation the rights */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell */
+/* copies of the Software, and to permit persons to whom the Software is */
+/* furnished to do so, subject to the following conditions: */
+
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software. */
+
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE */
+/* SOFTWARE. */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "arducam_mega_jpeg.h"
+#include "jpeg_fixture.h"
+
+static uint8_t fixture[512];
+
+/* Feeds @p length bytes in chunks of @p chunk bytes, returns the scan result */
+static int scan_chunked(struct arducam_mega_jpeg_scanner *scanner, const uint8_t *buffer,
+			size_t length, size_t chunk, size_t *consumed)
+{
+	size_t pos = 0;
+	size_t used;
+	int ret = ARDUCAM_MEGA_JPEG_MORE;
+
+	arducam_mega_jpeg_scan_init(scanner);
+	while (pos < length) {
+		size_t count = MIN(chunk, length - pos);
+
+		ret = arducam_mega_jpeg_scan(scanner, &buffer[pos], count, &used);
+		if (ret < 0) {
+			break;
+		}
+		zassert_true(used <= count, "used %zu of %zu", used, count);
+		pos += used;
+		if (ret == ARDUCAM_MEGA_JPEG_COMPLETE) {
+			break;
+		}
+		zassert_equal(used, count, "chunk not fully consumed");
+	}
+	*consumed = pos;
+	return ret;
+}
+
+ZTEST(jpeg_scanner, test_find_frame)
+{
+	struct jpeg_fixture fx;
+	size_t start, end;
+
+	jpeg_fixture_build(&fx, fixture, sizeof(fixture));
+	zassert_ok(arducam_mega_jpeg_find_frame(fx.data, fx.length, &start, &end));
+	zassert_equal(start, fx.soi);
+	zassert_equal(end, fx.eoi_end);
+}
+
+ZTEST(jpeg_scanner, test_split_at_every_boundary)
+{
+	struct arducam_mega_jpeg_scanner scanner;
+	struct jpeg_fixture fx;
+	size_t used, total;
+	int ret;
+
+	jpeg_fixture_build(&fx, fixture, sizeof(fixture));
+	for (size_t split = 0; split <= fx.length; split++) {
+		arducam_mega_jpeg_scan_init(&scanner);
+		ret = arducam_mega_jpeg_scan(&scanner, fx.data, split, &used);
+		zassert_true(ret >= 0, "split %zu failed %d", split, ret);
+		total = used;
+		if (ret == ARDUCAM_MEGA_JPEG_MORE) {
+			zassert_equal(used, split);
+			ret = arducam_mega_jpeg_scan(&scanner, &fx.data[split], fx.length - split,
+						     &used);
+			total += used;
+		}
+		zassert_equal(ret, ARDUCAM_MEGA_JPEG_COMPLETE, "split %zu", split);
+		zassert_equal(scanner.soi, fx.soi, "split %zu", split);
+		zassert_equal(scanner.end, fx.eoi_end, "split %zu", split);
+		zassert_equal(total, fx.eoi_end, "split %zu", split);
+	}
+}
+
+ZTEST(jpeg_scanner, test_chunk_sizes)
+{
+	struct arducam_mega_jpeg_scanner scanner;
+	struct jpeg_fixture fx;
+	size_t consumed;
+
+	jpeg_fixture_build(&fx, fixture, sizeof(fixture));
+	for (size_t chunk = 1; chunk <= 64; chunk++) {
+		zassert_equal(scan_chunked(&scanner, fx.data, fx.length, chunk, &consumed),
+			      ARDUCAM_MEGA_JPEG_COMPLETE, "chunk %zu", chunk);
+		zassert_equal(scanner.soi, fx.soi, "chunk %zu", chunk);
+		zassert_equal(scanner.end, fx.eoi_end, "chunk %zu", chunk);
+		zassert_equal(consumed, fx.eoi_end, "chunk %zu", chunk);
+	}
+}
+
+ZTEST(jpeg_scanner, test_byte_stuffing)
+{
+	/* Stuffed 0xFF00 pairs followed by 0xD9 data bytes do not end the scan */
+	static const uint8_t jpeg[] = {
+		0xff, 0xd8, 0xff, 0xda, 0x00, 0x02, 0x12, 0xff, 0x00, 0xd9, 0xff,
+		0x00, 0xff, 0x00, 0xd9, 0x34, 0xff, 0xd9, 0xaa, 0xbb,
+	};
+	size_t start, end;
+
+	zassert_ok(arducam_mega_jpeg_find_frame(jpeg, sizeof(jpeg), &start, &end));
+	zassert_equal(start, 0);
+	zassert_equal(end, sizeof(jpeg) - 2);
+}
+
+ZTEST(jpeg_scanner, test_restart_markers)
+{
+	static const uint8_t jpeg[] = {
+		0xff, 0xd8, 0xff, 0xda, 0x00, 0x02, 0x12, 0xff, 0xd0, 0x34,
+		0xff, 0xd7, 0x56, 0xff, 0xd9,
+	};
+	/* Restart markers are only valid inside a scan */
+	static const uint8_t bad[] = {0xff, 0xd8, 0xff, 0xd0, 0xff, 0xd9};
+	size_t start, end;
+
+	zassert_ok(arducam_mega_jpeg_find_frame(jpeg, sizeof(jpeg), &start, &end));
+	zassert_equal(end, sizeof(jpeg));
+	zassert_equal(arducam_mega_jpeg_find_frame(bad, sizeof(bad), &start, &end), -EBADMSG);
+}
+
+ZTEST(jpeg_scanner, test_fill_bytes)
+{
+	/* Any number of 0xFF may precede a marker code, in headers and in scans */
+	static const uint8_t jpeg[] = {
+		0xff, 0xd8, 0xff, 0xff, 0xff, 0xdb, 0x00, 0x03, 0x00, 0xff, 0xff, 0xda,
+		0x00, 0x02, 0x12, 0xff, 0xff, 0xd0, 0x34, 0xff, 0xff, 0xff, 0xd9,
+	};
+	size_t start, end;
+
+	zassert_ok(arducam_mega_jpeg_find_frame(jpeg, sizeof(jpeg), &start, &end));
+	zassert_equal(start, 0);
+	zassert_equal(end, sizeof(jpeg));
+}
+
+ZTEST(jpeg_scanner, test_exif_thumbnail)
+{
+	/* The APP1 payload holds a complete JPEG that must be skipped */
+	static const uint8_t jpeg[] = {
+		0xff, 0xd8, 0xff, 0xe1, 0x00, 0x0a, 0x45, 0x78, 0xff, 0xd8,
+		0xff, 0xd9, 0xff, 0xd9, 0xff, 0xda, 0x00, 0x02, 0x12, 0xff, 0xd9,
+	};
+	size_t start, end;
+
+	zassert_ok(arducam_mega_jpeg_find_frame(jpeg, sizeof(jpeg), &start, &end));
+	zassert_equal(start, 0);
+	zassert_equal(end, sizeof(jpeg));
+}
+
+ZTEST(jpeg_scanner, test_padding)
+{
+	/* FIFO padding before SOI, including stray 0xFF bytes, is skipped */
+	static const uint8_t jpeg[] = {
+		0x00, 0xff, 0x00, 0xff, 0xff, 0x12, 0xff, 0xd8,
+		0xff, 0xda, 0x00, 0x02, 0x12, 0xff, 0xd9, 0x00,
+	};
+	size_t start, end;
+
+	zassert_ok(arducam_mega_jpeg_find_frame(jpeg, sizeof(jpeg), &start, &end));
+	zassert_equal(start, 6);
+	zassert_equal(end, sizeof(jpeg) - 1);
+}
+
+ZTEST(jpeg_scanner, test_malformed)
+{
+	/* Header bytes must start a marker */
+	static const uint8_t no_marker[] = {0xff, 0xd8, 0x12, 0xff, 0xd9};
+	/* A segment length counts its own two bytes */
+	static const uint8_t short_length[] = {0xff, 0xd8, 0xff, 0xdb, 0x00, 0x01, 0xff, 0xd9};
+	/* Byte stuffing outside a scan */
+	static const uint8_t stuffed[] = {0xff, 0xd8, 0xff, 0x00, 0xff, 0xd9};
+	size_t start, end;
+
+	zassert_equal(arducam_mega_jpeg_find_frame(no_marker, sizeof(no_marker), &start, &end),
+		      -EBADMSG);
+	zassert_equal(
+		arducam_mega_jpeg_find_frame(short_length, sizeof(short_length), &start, &end),
+		-EBADMSG);
+	zassert_equal(arducam_mega_jpeg_find_frame(stuffed, sizeof(stuffed), &start, &end),
+		      -EBADMSG);
+}
+
+ZTEST(jpeg_scanner, test_incomplete)
+{
+	struct jpeg_fixture fx;
+	size_t start, end;
+
+	jpeg_fixture_build(&fx, fixture, sizeof(fixture));
+	zassert_equal(arducam_mega_jpeg_find_frame(fx.data, fx.eoi_end - 1, &start, &end),
+		      -ENODATA);
+	zassert_equal(arducam_mega_jpeg_find_frame(fx.data, fx.soi, &start, &end), -ENODATA);
+}
+
+ZTEST_SUITE(jpeg_scanner, NULL, NULL, NULL, NULL, NULL);